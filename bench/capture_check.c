@@ -0,0 +1,149 @@
+#include "simd_capture.h"
+#include "simd_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Checks that rings stay in timestamp order when a reservoir callsite captures alongside one that
+// captures every call, which the collector's merge and the trace index both rely on. Plain rings,
+// wrapped ones, collector rings that drop what doesn't fit and the trace written from them.
+//
+//   capture_check [trace file]
+
+#define ITERATIONS 1000
+#define SAMPLES    16
+
+static uint32_t failures;
+
+static void
+check(bool ok, const char* what)
+{
+	printf("%-40s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+static bool
+ring_sorted(const SimdCaptureRing* ring)
+{
+	for (uint64_t i = 1; i < simd_capture_count(ring); ++i)
+	{
+		if (simd_capture_at(ring, i)->timestamp < simd_capture_at(ring, i - 1)->timestamp)
+			return false;
+	}
+	return true;
+}
+
+// The reservoir callsite captures first, so most samples land between captures of the other one
+static void
+capture_loop(SimdCaptureRing* ring, uint32_t always, uint32_t sampled)
+{
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		simd_viewer_capture(ring, sampled, _mm256_set1_epi32(i), REGISTER_TYPE_S32);
+		simd_viewer_capture(ring, always, _mm256_set1_epi32(i), REGISTER_TYPE_S32);
+	}
+}
+
+static uint32_t
+sampled_callsite(SimdCaptureRing* ring)
+{
+	uint32_t callsite = simd_capture_callsite(ring, "sampled");
+	simd_capture_set_trigger(ring, callsite, (SimdCaptureTrigger) { .sampling = SIMD_CAPTURE_SAMPLE_RESERVOIR, .n = SAMPLES });
+	return callsite;
+}
+
+typedef struct {
+	uint64_t last;
+	uint64_t count;
+	bool     sorted;
+} Emitted;
+
+static void
+emit_check(void* user, const SimdCaptureRing* ring, const SimdCaptureRecord* record)
+{
+	(void)ring;
+	Emitted* emitted = user;
+	if (record->timestamp < emitted->last)
+		emitted->sorted = false;
+	emitted->last = record->timestamp;
+	emitted->count++;
+}
+
+int
+main(int argc, char** argv)
+{
+	const char* trace_file = (argc > 1) ? argv[1] : "bin/capture_check.trace";
+
+	SimdCaptureRing ring;
+	simd_capture_init(&ring, 1 << 12);
+	uint32_t always = simd_capture_callsite(&ring, "always");
+	uint32_t sampled = sampled_callsite(&ring);
+	capture_loop(&ring, always, sampled);
+	check(simd_capture_count(&ring) == 0, "held back until the flush");
+	simd_capture_flush_reservoirs(&ring);
+	check(simd_capture_count(&ring) == ITERATIONS + SAMPLES, "every capture and sample published");
+	check(ring_sorted(&ring), "ring in timestamp order");
+	capture_loop(&ring, always, sampled);
+	simd_capture_flush_reservoirs(&ring);
+	check(simd_capture_count(&ring) == 2 * (ITERATIONS + SAMPLES), "second flush appended");
+	check(ring_sorted(&ring), "ring in order across flushes");
+
+	SimdTraceWriter writer;
+	SimdTrace trace;
+	bool traced = simd_trace_writer_open(&writer, trace_file, 64, 0);
+	if (traced)
+	{
+		simd_trace_write_ring(&writer, &ring);
+		traced = simd_trace_writer_close(&writer) && simd_trace_open(&trace, trace_file);
+	}
+	check(traced, "trace written");
+	if (traced)
+	{
+		bool found = true;
+		for (uint64_t i = 0; i < simd_capture_count(&ring); ++i)
+		{
+			uint64_t timestamp = simd_capture_at(&ring, i)->timestamp;
+			uint64_t record = simd_trace_find_timestamp(&trace, timestamp);
+			if (record > i || (record < i && simd_capture_at(&ring, record)->timestamp < timestamp))
+				found = false;
+		}
+		check(found, "trace finds every timestamp");
+		simd_trace_close(&trace);
+		remove(trace_file);
+	}
+	simd_capture_free(&ring);
+
+	simd_capture_init(&ring, 256);
+	always = simd_capture_callsite(&ring, "always");
+	sampled = sampled_callsite(&ring);
+	capture_loop(&ring, always, sampled);
+	simd_capture_flush_reservoirs(&ring);
+	check(simd_capture_count(&ring) == 256, "wrapped ring kept its capacity");
+	check(ring_sorted(&ring), "wrapped ring in timestamp order");
+	simd_capture_free(&ring);
+
+	// Big enough for everything, then small enough that the samples don't fit
+	static const uint64_t collector_capacities[] = { 1 << 12, 512 };
+	for (int c = 0; c < 2; ++c)
+	{
+		uint64_t capacity = collector_capacities[c];
+		uint64_t kept = (capacity < ITERATIONS + SAMPLES) ? capacity : ITERATIONS + SAMPLES;
+		SimdCaptureCollector collector;
+		simd_capture_collector_init(&collector, capacity);
+		SimdCaptureRing* thread_ring = simd_capture_thread_ring(&collector);
+		always = simd_capture_callsite(thread_ring, "always");
+		sampled = sampled_callsite(thread_ring);
+		capture_loop(thread_ring, always, sampled);
+		simd_capture_flush_reservoirs(thread_ring);
+		check(thread_ring->dropped == ITERATIONS + SAMPLES - kept, c ? "full collector ring dropped the rest" : "collector ring dropped nothing");
+		Emitted emitted = { 0, 0, true };
+		simd_capture_collect(&collector, emit_check, &emitted);
+		check(emitted.count == kept && emitted.sorted, "collector emitted in timestamp order");
+		simd_capture_collector_free(&collector);
+	}
+
+	if (failures)
+		printf("%u checks failed\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+#include "simd_viewer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Times the kernel built with SIMD_VIEWER_DISABLE against the one written without pushes.
+// make bench_disable already checked their code is identical, this shows it costs nothing either.
+uint64_t kernel_disabled(SimdViewer* sv, const uint8_t* a, const uint8_t* b, size_t size);
+uint64_t kernel_plain(SimdViewer* sv, const uint8_t* a, const uint8_t* b, size_t size);
+
+#define BENCH_SIZE  (64 * 1024)
+#define BENCH_RUNS  21
+#define BENCH_CALLS 200
+
+typedef uint64_t Kernel(SimdViewer* sv, const uint8_t* a, const uint8_t* b, size_t size);
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int
+compare_u64(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+// Median over the runs of the time per call
+static double
+time_kernel(Kernel* kernel, const uint8_t* a, const uint8_t* b, uint64_t* checksum)
+{
+	uint64_t runs[BENCH_RUNS];
+	for (int run = 0; run < BENCH_RUNS; ++run)
+	{
+		uint64_t start = now_ns();
+		for (int call = 0; call < BENCH_CALLS; ++call)
+			*checksum += kernel(0, a, b, BENCH_SIZE);
+		runs[run] = now_ns() - start;
+	}
+	qsort(runs, BENCH_RUNS, sizeof(*runs), compare_u64);
+	return (double)runs[BENCH_RUNS / 2] / BENCH_CALLS;
+}
+
+int
+main(void)
+{
+	uint8_t* a = malloc(BENCH_SIZE);
+	uint8_t* b = malloc(BENCH_SIZE);
+	for (size_t i = 0; i < BENCH_SIZE; ++i)
+	{
+		a[i] = (uint8_t)(i * 7 + 3);
+		b[i] = (uint8_t)(i * 13 + 1);
+	}
+
+	uint64_t checksum_disabled = 0, checksum_plain = 0;
+	time_kernel(kernel_disabled, a, b, &checksum_disabled);  // warmup
+	time_kernel(kernel_plain, a, b, &checksum_plain);
+	double disabled = time_kernel(kernel_disabled, a, b, &checksum_disabled);
+	double plain = time_kernel(kernel_plain, a, b, &checksum_plain);
+
+	printf("kernel        ns/call   bytes/ns\n");
+	printf("disabled   %10.1f %10.2f\n", disabled, BENCH_SIZE / disabled);
+	printf("plain      %10.1f %10.2f\n", plain, BENCH_SIZE / plain);
+	printf("checksums %s\n", (checksum_disabled == checksum_plain) ? "match" : "DIFFER");
+
+	free(a);
+	free(b);
+	return (checksum_disabled == checksum_plain) ? 0 : 1;
+}
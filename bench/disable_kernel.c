@@ -0,0 +1,61 @@
+#include "simd_viewer.h"
+
+// Built twice by make bench_disable, once with the pushes compiled out by SIMD_VIEWER_DISABLE
+// and once as written without them (SIMD_VIEWER_BENCH_PLAIN). The .text of both has to match.
+#if !defined(KERNEL_NAME)
+#define KERNEL_NAME kernel
+#endif
+
+#if !defined(SIMD_VIEWER_BENCH_PLAIN)
+
+// Sum of absolute differences of two byte rows, instrumented like the examples in main.c
+uint64_t
+KERNEL_NAME(SimdViewer* sv, const uint8_t* a, const uint8_t* b, size_t size)
+{
+	__m256i sum = _mm256_setzero_si256();
+	simd_viewer_push_highlighter(sv);
+	for (size_t i = 0; i + sizeof(__m256i) <= size; i += sizeof(__m256i))
+	{
+		__m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+		simd_viewer_push(sv, va, REGISTER_TYPE_U8);
+		simd_viewer_push(sv, vb, REGISTER_TYPE_U8);
+
+		__m256i sad = _mm256_sad_epu8(va, vb);
+		simd_viewer_push_operation(sv, REGISTER_TYPE_U64, "_mm256_sad_epu8");
+		simd_viewer_set_hexadecimal_render(sv);
+		simd_viewer_push_bold(sv, sad, REGISTER_TYPE_U64);
+		simd_viewer_set_decimal_render(sv);
+
+		sum = _mm256_add_epi64(sum, sad);
+		simd_viewer_push_operation(sv, REGISTER_TYPE_U64, "_mm256_add_epi64");
+		simd_viewer_push(sv, sum, REGISTER_TYPE_U64);
+		simd_viewer_push_mask32(sv, (__mmask32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+		simd_viewer_push_empty(sv);
+	}
+
+	__m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	simd_viewer_push128(sv, half, REGISTER_TYPE_U64);
+	return (uint64_t)_mm_cvtsi128_si64(half) + (uint64_t)_mm_extract_epi64(half, 1);
+}
+
+#else
+
+uint64_t
+KERNEL_NAME(SimdViewer* sv, const uint8_t* a, const uint8_t* b, size_t size)
+{
+	(void)sv;
+	__m256i sum = _mm256_setzero_si256();
+	for (size_t i = 0; i + sizeof(__m256i) <= size; i += sizeof(__m256i))
+	{
+		__m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+		__m256i sad = _mm256_sad_epu8(va, vb);
+		sum = _mm256_add_epi64(sum, sad);
+	}
+
+	__m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	return (uint64_t)_mm_cvtsi128_si64(half) + (uint64_t)_mm_extract_epi64(half, 1);
+}
+
+#endif
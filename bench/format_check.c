@@ -0,0 +1,173 @@
+#include "simd_format.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Compares simd_format_lanes against snprintf with the formats the viewer used to print lanes with,
+// for every lane type in decimal and hex. 8 and 16 bit lanes are checked exhaustively, wider ones
+// on their edge values and a pseudo random sweep. Built with the optimized bench flags, since the
+// vector paths are what the optimizer can get wrong.
+//
+//   format_check [--samples N]
+
+#define DEFAULT_SAMPLES (1u << 20)
+#define MAX_LANES       64
+#define MAX_REPORTED    10
+
+static const char* type_names[] = { "", "s8", "s16", "s32", "s64", "u8", "u16", "u32", "u64", "f32", "f64" };
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+static uint32_t mismatches;
+
+static uint64_t
+next_random(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+static uint32_t
+lane_bytes(RegisterType type)
+{
+	switch (type)
+	{
+		case REGISTER_TYPE_S8:  case REGISTER_TYPE_U8:  return 1;
+		case REGISTER_TYPE_S16: case REGISTER_TYPE_U16: return 2;
+		case REGISTER_TYPE_S32: case REGISTER_TYPE_U32: case REGISTER_TYPE_F32: return 4;
+		default: return 8;
+	}
+}
+
+// What printf made of the lane, with signed lanes promoted to int before %x
+static void
+expected_text(const SimdLanes* lanes, RegisterType type, int lane, bool hex, char* text, size_t size)
+{
+	switch (type)
+	{
+		case REGISTER_TYPE_S8:  snprintf(text, size, hex ? "0x%x" : "%d", lanes->s8[lane]); break;
+		case REGISTER_TYPE_S16: snprintf(text, size, hex ? "0x%x" : "%d", lanes->s16[lane]); break;
+		case REGISTER_TYPE_S32: snprintf(text, size, hex ? "0x%x" : "%d", lanes->s32[lane]); break;
+		case REGISTER_TYPE_U8:  snprintf(text, size, hex ? "0x%x" : "%u", lanes->u8[lane]); break;
+		case REGISTER_TYPE_U16: snprintf(text, size, hex ? "0x%x" : "%u", lanes->u16[lane]); break;
+		case REGISTER_TYPE_U32: snprintf(text, size, hex ? "0x%x" : "%u", lanes->u32[lane]); break;
+		case REGISTER_TYPE_S64: snprintf(text, size, hex ? "0x%" PRIx64 : "%" PRId64, lanes->s64[lane]); break;
+		case REGISTER_TYPE_U64: snprintf(text, size, hex ? "0x%" PRIx64 : "%" PRIu64, lanes->u64[lane]); break;
+		case REGISTER_TYPE_F32: snprintf(text, size, "%f", lanes->f32[lane]); break;
+		case REGISTER_TYPE_F64: snprintf(text, size, "%f", lanes->f64[lane]); break;
+		default: text[0] = 0; break;
+	}
+}
+
+static void
+check_lanes(Light_Arena* arena, const SimdLanes* lanes, RegisterType type, int lane_count)
+{
+	for (int hex = 0; hex < 2; ++hex)
+	{
+		const char* out[MAX_LANES];
+		simd_format_lanes(arena, lanes, type, lane_count, hex, out);
+		for (int lane = 0; lane < lane_count; ++lane)
+		{
+			char expected[512];
+			expected_text(lanes, type, lane, hex, expected, sizeof(expected));
+			if (strcmp(out[lane], expected) == 0)
+				continue;
+			if (mismatches++ < MAX_REPORTED)
+				fprintf(stderr, "%s %s lane %d: got \"%s\", expected \"%s\"\n", type_names[type], hex ? "hex" : "dec", lane, out[lane], expected);
+		}
+	}
+	arena_clear(arena);
+}
+
+// Every value of the lane width, a register full at a time, also formatted 4 lanes at a time
+// like the 32 bit lanes of a 128 bit register
+static void
+check_exhaustive(Light_Arena* arena, RegisterType type)
+{
+	uint32_t bytes = lane_bytes(type);
+	uint32_t lane_count = sizeof(__m512i) / bytes;
+	uint32_t value_count = 1u << (bytes * 8);
+	for (uint32_t first = 0; first < value_count; first += lane_count)
+	{
+		SimdLanes lanes = { 0 };
+		for (uint32_t lane = 0; lane < lane_count; ++lane)
+		{
+			if (bytes == 1)
+				lanes.u8[lane] = (uint8_t)(first + lane);
+			else
+				lanes.u16[lane] = (uint16_t)(first + lane);
+		}
+		check_lanes(arena, &lanes, type, lane_count);
+		check_lanes(arena, &lanes, type, 4);
+	}
+}
+
+// Powers of ten and of two around each, the extremes, then random bit patterns of every width
+static void
+check_sampled(Light_Arena* arena, RegisterType type, uint32_t samples)
+{
+	uint32_t bytes = lane_bytes(type);
+	uint32_t lane_count = sizeof(__m512i) / bytes;
+
+	uint64_t edges[256];
+	uint32_t edge_count = 0;
+	for (uint64_t power = 1; power && edge_count + 3 <= 128; power = (power <= UINT64_MAX / 10) ? power * 10 : 0)
+	{
+		edges[edge_count++] = power - 1;
+		edges[edge_count++] = power;
+		edges[edge_count++] = 0 - power;
+	}
+	for (uint32_t bit = 0; bit < 64; ++bit)
+	{
+		edges[edge_count++] = 1ull << bit;
+		edges[edge_count++] = (1ull << bit) - 1;
+	}
+
+	SimdLanes lanes = { 0 };
+	uint32_t lane = 0;
+	for (uint32_t i = 0; i < edge_count + samples; ++i)
+	{
+		uint64_t bits = (i < edge_count) ? edges[i] : next_random() >> (next_random() % 64);
+		if (bytes == 4)
+			lanes.u32[lane] = (uint32_t)bits;
+		else
+			lanes.u64[lane] = bits;
+		if (++lane == lane_count)
+		{
+			check_lanes(arena, &lanes, type, lane_count);
+			lane = 0;
+		}
+	}
+	check_lanes(arena, &lanes, type, 4);
+}
+
+int
+main(int argc, char** argv)
+{
+	uint32_t samples = DEFAULT_SAMPLES;
+	if (argc == 3 && strcmp(argv[1], "--samples") == 0)
+		samples = (uint32_t)strtoul(argv[2], 0, 10);
+	else if (argc != 1)
+	{
+		fprintf(stderr, "usage: %s [--samples N]\n", argv[0]);
+		return 1;
+	}
+
+	Light_Arena* arena = arena_create(64 * 1024);
+	for (RegisterType type = REGISTER_TYPE_S8; type <= REGISTER_TYPE_F64; ++type)
+	{
+		uint32_t before = mismatches;
+		if (lane_bytes(type) <= 2)
+			check_exhaustive(arena, type);
+		else
+			check_sampled(arena, type, samples);
+		printf("%4s %s\n", type_names[type], (mismatches == before) ? "ok" : "MISMATCH");
+	}
+	arena_free(arena);
+
+	if (mismatches)
+		printf("%u lanes differ from snprintf\n", mismatches);
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,252 @@
+#include "simd_viewer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Frame cost of the viewer on synthetic stacks: N rows of one lane type, hex or decimal, with or
+// without the highlighter. Every frame pushes the rows and flushes them headlessly into an image
+// tall enough for every row to be drawn. The values change every frame, so the lane cache doesn't
+// hide the formatting.
+//
+//   bench_viewer [--frames N] [--json file]
+//
+// --json writes one JSON object per configuration and line, to compare runs across commits.
+
+#define WARMUP_FRAMES  3
+#define DEFAULT_FRAMES 30
+#define IMAGE_WIDTH    1600
+
+static const uint32_t row_counts[] = { 4, 16, 64 };
+static const RegisterType lane_types[] = {
+	REGISTER_TYPE_U8, REGISTER_TYPE_S16, REGISTER_TYPE_U32, REGISTER_TYPE_S64, REGISTER_TYPE_F32, REGISTER_TYPE_F64,
+};
+static const char* type_names[] = { "", "s8", "s16", "s32", "s64", "u8", "u16", "u32", "u64", "f32", "f64" };
+
+// Percentiles reported for every metric, the last one is the slowest frame
+static const uint32_t percentiles[] = { 0, 50, 90, 99, 100 };
+
+#define ARRAY_LENGTH(A) (sizeof(A) / sizeof(*(A)))
+#define HISTOGRAM_BUCKETS 64
+
+typedef struct {
+	uint32_t     rows;
+	RegisterType type;
+	bool         hex;
+	bool         highlight;
+} Workload;
+
+typedef struct {
+	uint64_t* push;   // ns of the pushes of each frame
+	uint64_t* flush;  // ns of the flush of each frame
+	uint64_t* frame;
+	uint32_t  frames;
+} Samples;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int
+compare_u64(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+static uint32_t
+lanes_per_row(RegisterType type)
+{
+	switch (type)
+	{
+		case REGISTER_TYPE_S8:  case REGISTER_TYPE_U8:  return 32;
+		case REGISTER_TYPE_S16: case REGISTER_TYPE_U16: return 16;
+		case REGISTER_TYPE_S32: case REGISTER_TYPE_U32: case REGISTER_TYPE_F32: return 8;
+		default: return 4;
+	}
+}
+
+static void
+push_rows(SimdViewer* sv, const Workload* workload, uint32_t frame)
+{
+	if (workload->hex)
+		simd_viewer_set_hexadecimal_render(sv);
+	if (workload->highlight)
+	{
+		simd_viewer_set_highlight_size(sv, workload->type);
+		simd_viewer_push_highlighter(sv);
+	}
+	else
+	{
+		simd_viewer_reset_hightlight_size(sv);
+	}
+
+	simd_viewer_push_operation(sv, workload->type, "bench");
+	for (uint32_t row = 0; row < workload->rows; ++row)
+	{
+		int32_t seed = (int32_t)(frame * 7919u + row * 104729u);
+		__m256i bits = _mm256_mullo_epi32(_mm256_set1_epi32(seed), _mm256_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15));
+		if (workload->type == REGISTER_TYPE_F32)
+			simd_viewer_pushf(sv, _mm256_cvtepi32_ps(bits), workload->type);
+		else if (workload->type == REGISTER_TYPE_F64)
+			simd_viewer_pushd(sv, _mm256_cvtepi32_pd(_mm256_castsi256_si128(bits)), workload->type);
+		else
+			simd_viewer_push(sv, bits, workload->type);
+	}
+}
+
+static void
+run_workload(SimdViewer* sv, const Workload* workload, Samples* samples)
+{
+	// Banner, highlighter and rows, with some room below
+	int height = (int)((workload->rows + 3) * (BYTE_SIZE + Y_SPACING));
+	for (uint32_t frame = 0; frame < WARMUP_FRAMES + samples->frames; ++frame)
+	{
+		uint64_t start = now_ns();
+		push_rows(sv, workload, frame);
+		uint64_t pushed = now_ns();
+		Image image = simd_viewer_render_image(sv, IMAGE_WIDTH, height);
+		UnloadImage(image);
+		uint64_t flushed = now_ns();
+
+		if (frame < WARMUP_FRAMES)
+			continue;
+		uint32_t i = frame - WARMUP_FRAMES;
+		samples->push[i] = pushed - start;
+		samples->flush[i] = flushed - pushed;
+		samples->frame[i] = flushed - start;
+	}
+}
+
+static double
+percentile(const uint64_t* sorted, uint32_t count, uint32_t p)
+{
+	return (double)sorted[(uint64_t)(count - 1) * p / 100];
+}
+
+static void
+sort_samples(Samples* samples)
+{
+	qsort(samples->push, samples->frames, sizeof(uint64_t), compare_u64);
+	qsort(samples->flush, samples->frames, sizeof(uint64_t), compare_u64);
+	qsort(samples->frame, samples->frames, sizeof(uint64_t), compare_u64);
+}
+
+static void
+json_percentiles(FILE* file, const char* name, const uint64_t* sorted, uint32_t count, double divisor)
+{
+	fprintf(file, ",\"%s\":{", name);
+	for (uint32_t i = 0; i < ARRAY_LENGTH(percentiles); ++i)
+		fprintf(file, "%s\"p%u\":%.3f", i ? "," : "", percentiles[i], percentile(sorted, count, percentiles[i]) / divisor);
+	fprintf(file, "}");
+}
+
+// Frames per power of two of their ns, [lower bound, count] for the buckets that have any
+static void
+json_histogram(FILE* file, const uint64_t* frame, uint32_t count)
+{
+	uint32_t buckets[HISTOGRAM_BUCKETS] = { 0 };
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t bucket = 0;
+		while (bucket + 1 < HISTOGRAM_BUCKETS && (frame[i] >> (bucket + 1)))
+			bucket++;
+		buckets[bucket]++;
+	}
+
+	fprintf(file, ",\"frame_ns_histogram\":[");
+	bool first = true;
+	for (uint32_t bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket)
+	{
+		if (!buckets[bucket])
+			continue;
+		fprintf(file, "%s[%llu,%u]", first ? "" : ",", 1ull << bucket, buckets[bucket]);
+		first = false;
+	}
+	fprintf(file, "]");
+}
+
+static void
+write_json(FILE* file, const Workload* workload, const Samples* samples)
+{
+	uint32_t lanes = workload->rows * lanes_per_row(workload->type);
+	fprintf(file, "{\"rows\":%u,\"type\":\"%s\",\"hex\":%s,\"highlight\":%s,\"lanes\":%u,\"frames\":%u",
+		workload->rows, type_names[workload->type], workload->hex ? "true" : "false", workload->highlight ? "true" : "false", lanes, samples->frames);
+	json_percentiles(file, "push_ns_per_row", samples->push, samples->frames, workload->rows);
+	json_percentiles(file, "flush_ns_per_row", samples->flush, samples->frames, workload->rows);
+	json_percentiles(file, "frame_ns_per_row", samples->frame, samples->frames, workload->rows);
+	json_percentiles(file, "frame_ns_per_lane", samples->frame, samples->frames, lanes);
+	json_histogram(file, samples->frame, samples->frames);
+	fprintf(file, "}\n");
+}
+
+static void
+print_row(const Workload* workload, const Samples* samples)
+{
+	uint32_t lanes = workload->rows * lanes_per_row(workload->type);
+	uint32_t count = samples->frames;
+	printf("%5u %4s %4s %4s %9.0f %9.0f %9.0f %9.0f %9.0f %9.0f %8.1f %8.1f\n",
+		workload->rows, type_names[workload->type], workload->hex ? "hex" : "dec", workload->highlight ? "on" : "off",
+		percentile(samples->push, count, 50) / workload->rows, percentile(samples->push, count, 99) / workload->rows,
+		percentile(samples->flush, count, 50) / workload->rows, percentile(samples->flush, count, 99) / workload->rows,
+		percentile(samples->frame, count, 50) / workload->rows, percentile(samples->frame, count, 99) / workload->rows,
+		percentile(samples->frame, count, 50) / lanes, percentile(samples->frame, count, 99) / lanes);
+}
+
+int
+main(int argc, char** argv)
+{
+	uint32_t frames = DEFAULT_FRAMES;
+	const char* json_path = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			frames = (uint32_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			json_path = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [--frames N] [--json file]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (frames == 0)
+		frames = 1;
+
+	FILE* json = 0;
+	if (json_path && !(json = fopen(json_path, "w")))
+	{
+		fprintf(stderr, "can't write %s\n", json_path);
+		return 1;
+	}
+
+	SimdViewer sv = { 0 };
+	simd_viewer_init_headless(&sv);
+
+	Samples samples = { malloc(frames * sizeof(uint64_t)), malloc(frames * sizeof(uint64_t)), malloc(frames * sizeof(uint64_t)), frames };
+	printf("                      push ns/row        flush ns/row        frame ns/row      frame ns/lane\n");
+	printf(" rows type base   hl       p50       p99       p50       p99       p50       p99      p50      p99\n");
+	for (uint32_t r = 0; r < ARRAY_LENGTH(row_counts); ++r)
+	for (uint32_t t = 0; t < ARRAY_LENGTH(lane_types); ++t)
+	for (int hex = 0; hex < 2; ++hex)
+	for (int highlight = 0; highlight < 2; ++highlight)
+	{
+		Workload workload = { row_counts[r], lane_types[t], hex, highlight };
+		run_workload(&sv, &workload, &samples);
+		sort_samples(&samples);
+		print_row(&workload, &samples);
+		if (json)
+			write_json(json, &workload, &samples);
+	}
+
+	if (json)
+		fclose(json);
+	free(samples.push);
+	free(samples.flush);
+	free(samples.frame);
+	return 0;
+}
@@ -241,10 +241,10 @@ ht_internal_hash(void* key, uint32_t keysize_bytes)
 	__m128i hash = _mm_set_epi32(0x12345678, 0x12ABCDEF, 0x12345678, 0x12345678);
 	for (int i = 0; i < keysize_bytes / sizeof(__m128i); ++i)
 	{
-		__m128i keypart = _mm_loadu_epi64(key);
+		__m128i keypart = _mm_loadu_si128((const __m128i*)key);
 		hash = _mm_aesdec_si128(keypart, hash);
 		hash = _mm_aesdec_si128(hash, hash);
-		key = (char*)key + keysize_bytes;
+		key = (char*)key + sizeof(__m128i);
 	}
 
 	uint32_t mask[4] = { 0 };
@@ -259,13 +259,13 @@ ht_internal_hash(void* key, uint32_t keysize_bytes)
 		mask[2] = swap_uint32(mask[2]);
 		mask[3] = swap_uint32(mask[3]);
 
-		__m128i loadmask = _mm_loadu_epi64(mask);
+		__m128i loadmask = _mm_loadu_si128((const __m128i*)mask);
 		__m128 keypart = _mm_maskload_ps((const float*)key, loadmask);
 		hash = _mm_aesdec_si128(*(__m128i*) & keypart, hash);
 		hash = _mm_aesdec_si128(hash, hash);
 	}
 
-	return hash.m128i_u64[0];
+	return (uint64_t)_mm_cvtsi128_si64(hash);
 }
 
 static int
@@ -469,9 +469,9 @@ ht_alloc(HtTable* table, const char* key, int keysize_bytes)
 				switch (keysize_bytes)
 				{
 					case 8: if ((uint64_t)entry->key == *(uint64_t*)key) return entry->data; break;
-					case 4: if ((uint32_t)entry->key == *(uint32_t*)key) return entry->data; break;
-					case 2: if ((uint16_t)entry->key == *(uint16_t*)key) return entry->data; break;
-					case 1: if ((uint8_t)entry->key == *(uint8_t*)key) return entry->data; break;
+					case 4: if ((uint32_t)(uintptr_t)entry->key == *(uint32_t*)key) return entry->data; break;
+					case 2: if ((uint16_t)(uintptr_t)entry->key == *(uint16_t*)key) return entry->data; break;
+					case 1: if ((uint8_t)(uintptr_t)entry->key == *(uint8_t*)key) return entry->data; break;
 					default: {
 						if (table->keyequal(key, (const char*)entry->key, keysize_bytes))
 							return entry->data;
@@ -502,9 +502,9 @@ ht_alloc(HtTable* table, const char* key, int keysize_bytes)
 	switch (keysize_bytes)
 	{
 		case 8: entry->key = (void*)*(uint64_t*)key; break;
-		case 4: entry->key = (void*)*(uint32_t*)key; break;
-		case 2: entry->key = (void*)*(uint16_t*)key; break;
-		case 1: entry->key = (void*)*(uint8_t*)key; break;
+		case 4: entry->key = (void*)(uintptr_t)*(uint32_t*)key; break;
+		case 2: entry->key = (void*)(uintptr_t)*(uint16_t*)key; break;
+		case 1: entry->key = (void*)(uintptr_t)*(uint8_t*)key; break;
 		default: {
 			if (table->flags & HTABLE_DONT_COPY_KEYS)
 				entry->key = (void*)key;
@@ -557,9 +557,9 @@ ht_alloc(HtTable* table, const char* key, int keysize_bytes)
 				switch (keysize_bytes)
 				{
 					case 8: if ((uint64_t)entry->key == *(uint64_t*)key) return entry->data; break;
-					case 4: if ((uint32_t)entry->key == *(uint32_t*)key) return entry->data; break;
-					case 2: if ((uint16_t)entry->key == *(uint16_t*)key) return entry->data; break;
-					case 1: if ((uint8_t)entry->key == *(uint8_t*)key) return entry->data; break;
+					case 4: if ((uint32_t)(uintptr_t)entry->key == *(uint32_t*)key) return entry->data; break;
+					case 2: if ((uint16_t)(uintptr_t)entry->key == *(uint16_t*)key) return entry->data; break;
+					case 1: if ((uint8_t)(uintptr_t)entry->key == *(uint8_t*)key) return entry->data; break;
 					default: {
 						if (table->keyequal(key, (const char*)entry->key, keysize_bytes))
 							return entry->data;
@@ -579,9 +579,9 @@ ht_alloc(HtTable* table, const char* key, int keysize_bytes)
 	switch (keysize_bytes)
 	{
 		case 8: entry->key = (void*)*(uint64_t*)key; break;
-		case 4: entry->key = (void*)*(uint32_t*)key; break;
-		case 2: entry->key = (void*)*(uint16_t*)key; break;
-		case 1: entry->key = (void*)*(uint8_t*)key; break;
+		case 4: entry->key = (void*)(uintptr_t)*(uint32_t*)key; break;
+		case 2: entry->key = (void*)(uintptr_t)*(uint16_t*)key; break;
+		case 1: entry->key = (void*)(uintptr_t)*(uint8_t*)key; break;
 		default: {
 			if (table->flags & HTABLE_DONT_COPY_KEYS)
 				entry->key = (void*)key;
@@ -624,9 +624,9 @@ ht_get(HtTable* table, const char* key, int keysize_bytes)
 			switch (keysize_bytes)
 			{
 				case 8: if ((uint64_t)entry->key == *(uint64_t*)key) return entry->data; break;
-				case 4: if ((uint32_t)entry->key == *(uint32_t*)key) return entry->data; break;
-				case 2: if ((uint16_t)entry->key == *(uint16_t*)key) return entry->data; break;
-				case 1: if ((uint8_t)entry->key == *(uint8_t*)key) return entry->data; break;
+				case 4: if ((uint32_t)(uintptr_t)entry->key == *(uint32_t*)key) return entry->data; break;
+				case 2: if ((uint16_t)(uintptr_t)entry->key == *(uint16_t*)key) return entry->data; break;
+				case 1: if ((uint8_t)(uintptr_t)entry->key == *(uint8_t*)key) return entry->data; break;
 				default: {
 					if (table->keyequal(key, (const char*)entry->key, keysize_bytes))
 						return entry->data;
@@ -661,9 +661,9 @@ ht_get(HtTable* table, const char* key, int keysize_bytes)
 			switch (keysize_bytes)
 			{
 				case 8: if ((uint64_t)entry->key == *(uint64_t*)key) return entry->data; break;
-				case 4: if ((uint32_t)entry->key == *(uint32_t*)key) return entry->data; break;
-				case 2: if ((uint16_t)entry->key == *(uint16_t*)key) return entry->data; break;
-				case 1: if ((uint8_t)entry->key == *(uint8_t*)key) return entry->data; break;
+				case 4: if ((uint32_t)(uintptr_t)entry->key == *(uint32_t*)key) return entry->data; break;
+				case 2: if ((uint16_t)(uintptr_t)entry->key == *(uint16_t*)key) return entry->data; break;
+				case 1: if ((uint8_t)(uintptr_t)entry->key == *(uint8_t*)key) return entry->data; break;
 				default: {
 					if (table->keyequal(key, (const char*)entry->key, keysize_bytes))
 						return entry->data;
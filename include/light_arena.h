@@ -77,10 +77,15 @@ arena_alloc(Light_Arena* arena, size_t size_bytes) {
 #define arena_size(A) ((char*)((A)->ptr) - (char*)(A) + sizeof(Light_Arena))
     void* result;
     if (size_bytes + arena_size(arena->last) > arena->last->capacity) {
-        Light_Arena* narena = arena_create(arena->capacity);
-        arena->last->next = narena;
-        arena->last = narena;
-		arena->ptr = narena->ptr;
+        if (arena->last->next) {
+            /* reuse the blocks kept by arena_clear before growing */
+            arena->last = arena->last->next;
+        } else {
+            Light_Arena* narena = arena_create(arena->capacity);
+            arena->last->next = narena;
+            arena->last = narena;
+        }
+		arena->ptr = arena->last->ptr;
     }
 #undef arena_size
     result = arena->last->ptr;
@@ -108,6 +113,7 @@ arena_clear(Light_Arena* arena) {
         aux->ptr = aux + 1;
 		aux = next;
 	}
+	arena->last = arena;
 }
 
 #endif /* H_LIGHT_ARENA */
@@ -1,4 +1,7 @@
 #include "simd_viewer.h"
+#include "simd_stream.h"
+#include <stdlib.h>
+#include <string.h>
 
 void
 simd_compare(SimdViewer* sv)
@@ -50,6 +53,20 @@ simd_unpack(SimdViewer* sv)
 	}
 }
 
+void
+simd_shuffle(SimdViewer* sv)
+{
+	simd_viewer_push_highlighter(sv);
+
+	__m256i value = _mm256_set_epi32(1, 2, 3, 4, 5, 6, 7, 8);
+	simd_viewer_push(sv, value, REGISTER_TYPE_U32);
+
+	// The immediate is what tells the lane colours which element went where
+	__m256i result = _mm256_shuffle_epi32(value, 0x1B);
+	simd_viewer_push_operation_imm(sv, REGISTER_TYPE_U32, "_mm256_shuffle_epi32", 0x1B);
+	simd_viewer_push_bold(sv, result, REGISTER_TYPE_U32);
+}
+
 void
 simd_average(SimdViewer* sv)
 {
@@ -149,41 +166,346 @@ simd_add_float128(SimdViewer* sv)
 	simd_viewer_push128f_bold(sv, result, REGISTER_TYPE_F32);
 }
 
-int main()
+void
+simd_mask_add512(SimdViewer* sv)
 {
-	Font font = {0};
+	simd_viewer_push_highlighter(sv);
+
+	__m512i value0 = _mm512_set_epi32(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	simd_viewer_push512(sv, value0, REGISTER_TYPE_S32);
+	__m512i value1 = _mm512_set1_epi32(8);
+	simd_viewer_push512(sv, value1, REGISTER_TYPE_S32);
+
+	__mmask16 mask = _mm512_cmpgt_epi32_mask(value0, value1);
+	simd_viewer_push_operation(sv, REGISTER_TYPE_S32, "_mm512_cmpgt_epi32_mask");
+	simd_viewer_push_mask16(sv, mask);
+
+	__m512i result = _mm512_mask_add_epi32(value0, mask, value0, value1);
+	simd_viewer_push_operation(sv, REGISTER_TYPE_S32, "_mm512_mask_add_epi32");
+	simd_viewer_push512_masked(sv, result, mask, REGISTER_TYPE_S32);
+}
+
+void
+simd_capture_loop(SimdViewer* sv)
+{
+	// Captured from the loop without drawing anything, then replayed into the viewer
+	SimdCaptureRing ring;
+	simd_capture_init(&ring, 64);
+	uint32_t add_site = simd_capture_callsite(&ring, "_mm256_add_epi32");
+
+	__m256i sum = _mm256_setzero_si256();
+	__m256i step = _mm256_set_epi32(8, 7, 6, 5, 4, 3, 2, 1);
+	for (int i = 0; i < 4; ++i)
+	{
+		sum = _mm256_add_epi32(sum, step);
+		simd_viewer_capture_operation(&ring, add_site, REGISTER_TYPE_S32);
+		simd_viewer_capture(&ring, add_site, sum, REGISTER_TYPE_S32);
+	}
+
+	simd_viewer_replay(sv, &ring);
+	simd_capture_free(&ring);
+}
+
+void
+record_examples(SimdViewer* sv)
+{
+	// Examples, uncomment to see
+	simd_unpack(sv);
+	//simd_shuffle(sv);
+	//simd_compare(sv);
+	//simd_average(sv);
+	//simd_movehdup(sv);
+	//simd_compare_string(sv);
+	simd_add_float256(sv);
+	//simd_add_int128(sv);
+	//simd_add_float128(sv);
+	//simd_mask_add512(sv);
+	//simd_capture_loop(sv);
+}
+
+#define LISTEN_RING_CAPACITY 256
+
+int
+listen_viewer(const char* path)
+{
+	SimdStreamReceiver receiver;
+	if (!simd_stream_listen(&receiver, path))
+	{
+		fprintf(stderr, "Can't listen on %s\n", path);
+		return 1;
+	}
+
 	InitWindow(1600, 900, "Intrinsics");
 	SetWindowState(FLAG_WINDOW_RESIZABLE);
 	SetTargetFPS(60);
-	//SetExitKey(KEY_NULL);
 
 	SimdViewer sv = { 0 };
 	simd_viewer_init(&sv);
 
+	// Only the latest records are shown, older ones are overwritten as new ones arrive
+	SimdCaptureRing ring;
+	simd_capture_init(&ring, LISTEN_RING_CAPACITY);
+
 	while (!WindowShouldClose())
 	{
+		simd_stream_receive(&receiver, &ring);
+		simd_viewer_replay(&sv, &ring);
+
 		BeginDrawing();
+		ClearBackground(BACKGROUND_COLOR);
+		simd_viewer_flush(&sv);
+		DrawText(TextFormat("%s  received %llu  dropped by sender %llu", (receiver.connection >= 0) ? "connected" : "waiting",
+			(unsigned long long)receiver.received, (unsigned long long)receiver.sender_dropped), 8, GetScreenHeight() - 24, 20, LIGHTGRAY);
+		EndDrawing();
+	}
+
+	// The font and render target go before the GL context
+	simd_viewer_free(&sv);
+	CloseWindow();
+	simd_capture_free(&ring);
+	simd_stream_receiver_close(&receiver);
+	return 0;
+}
+
+// Stands in for an instrumented process, the viewer runs with --listen on the same socket
+int
+stream_examples(const char* path)
+{
+	SimdStreamSender sender;
+	simd_stream_sender_init(&sender, path);
+
+	SimdCaptureRing ring;
+	simd_capture_init(&ring, 1024);
+	uint32_t add_site = simd_capture_callsite(&ring, "_mm256_add_epi32");
+	uint32_t sum_site = simd_capture_callsite(&ring, "sum");
+
+	__m256i sum = _mm256_setzero_si256();
+	__m256i step = _mm256_set_epi32(8, 7, 6, 5, 4, 3, 2, 1);
+	for (uint64_t i = 0;; ++i)
+	{
+		sum = _mm256_add_epi32(sum, step);
+		simd_viewer_capture_operation(&ring, add_site, REGISTER_TYPE_S32);
+		simd_viewer_capture(&ring, sum_site, sum, REGISTER_TYPE_S32);
+
+		// Whatever the viewer can't take is dropped, the loop never waits for it
+		if ((i & 0xff) == 0)
+		{
+			simd_stream_send_ring(&sender, &ring);
+			simd_stream_flush(&sender);
+		}
+		if ((i & 0xfffff) == 0)
+		{
+			printf("\rsent %llu dropped %llu", (unsigned long long)sender.sent, (unsigned long long)sender.dropped);
+			fflush(stdout);
+		}
+	}
+}
+
+// Steps through the lane types, integers then floats
+static RegisterType
+next_register_type(RegisterType type, bool backwards)
+{
+	if (backwards)
+		return (type <= REGISTER_TYPE_S8) ? REGISTER_TYPE_F64 : type - 1;
+	return (type >= REGISTER_TYPE_F64) ? REGISTER_TYPE_S8 : type + 1;
+}
+
+int
+attach_viewer(int pid)
+{
+	SimdPtrace trace;
+	if (!simd_ptrace_attach(&trace, pid))
+	{
+		fprintf(stderr, "Can't attach to %d\n", pid);
+		return 1;
+	}
 
+	InitWindow(1600, 900, "Intrinsics");
+	SetWindowState(FLAG_WINDOW_RESIZABLE);
+	SetTargetFPS(30);
+
+	SimdViewer sv = { 0 };
+	simd_viewer_init(&sv);
+	simd_viewer_set_retained(&sv, true);
+
+	SimdRegisterFile registers = { 0 };
+	RegisterType types[32];
+	for (uint32_t i = 0; i < 32; ++i)
+		types[i] = REGISTER_TYPE_U32;
+
+	while (!WindowShouldClose())
+	{
+		// Space stops the process, S steps one instruction, C lets it run
+		if (IsKeyPressed(KEY_SPACE))
+			simd_ptrace_stop(&trace);
+		if (IsKeyPressed(KEY_S) || IsKeyPressedRepeat(KEY_S))
+			simd_ptrace_step(&trace);
+		if (IsKeyPressed(KEY_C))
+			simd_ptrace_continue(&trace);
+
+		// The registers are only read when the process stops, running it costs nothing
+		bool changed = false;
+		if (simd_ptrace_poll(&trace) && trace.state == SIMD_PTRACE_STOPPED)
+			changed = simd_ptrace_read(&trace, &registers);
+
+		// T changes the lane type of the register under the mouse, shift goes back
+		int32_t vector = (sv.hovered.row >= 0) ? sv.hovered.row / 2 : -1;
+		if (IsKeyPressed(KEY_T) && vector >= 0 && vector < (int32_t)registers.vector_count)
+		{
+			types[vector] = next_register_type(types[vector], IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT));
+			changed = true;
+		}
+
+		if (changed)
+		{
+			simd_viewer_clear(&sv);
+			simd_viewer_push_register_file(&sv, &registers, types);
+		}
+
+		static const char* states[] = { "detached", "running", "stopped", "exited" };
+		BeginDrawing();
 		ClearBackground(BACKGROUND_COLOR);
+		simd_viewer_flush(&sv);
+		DrawText(TextFormat("pid %d  %s  rip 0x%llx  stops %llu", pid, states[trace.state], (unsigned long long)registers.rip,
+			(unsigned long long)trace.stops), 8, GetScreenHeight() - 24, 20, LIGHTGRAY);
+		EndDrawing();
+	}
+
+	// The font and render target go before the GL context
+	simd_viewer_free(&sv);
+	CloseWindow();
+	simd_ptrace_detach(&trace);
+	return 0;
+}
+
+// In the working directory, where every run on the machine finds it
+#define BENCH_CACHE_PATH "simd_bench.cache"
+
+int bench_intrinsics(const char* cache_path)
+{
+	SimdBench bench;
+	simd_bench_init(&bench, cache_path);
+	printf("%s\n%-32s %8s %10s\n", bench.cpu, "intrinsic", "latency", "throughput");
+	for (uint32_t i = 0; i < simd_bench_intrinsic_count(); ++i)
+	{
+		SimdBenchResult result;
+		simd_bench_get(&bench, simd_bench_intrinsic_name(i), &result);
+		printf("%-32s %8.2f %10.3f\n", result.name, result.latency, result.throughput);
+	}
+	simd_bench_free(&bench);
+	return 0;
+}
 
+int main(int argc, char** argv)
+{
+	// --ansi prints the examples to the terminal
+	if (argc == 2 && strcmp(argv[1], "--ansi") == 0)
+	{
+		SimdViewer sv = { 0 };
+		simd_viewer_init_headless(&sv);
+		simd_viewer_set_highlight_size(&sv, REGISTER_TYPE_U32);
+		record_examples(&sv);
+		simd_viewer_print_ansi(&sv, stdout);
+		simd_viewer_free(&sv);
+		return 0;
+	}
+
+	// --headless <file.png> renders the examples on the CPU without opening a window
+	if (argc == 3 && strcmp(argv[1], "--headless") == 0)
+	{
+		SimdViewer sv = { 0 };
+		simd_viewer_init_headless(&sv);
+		record_examples(&sv);
+		Image image = simd_viewer_render_image(&sv, 1600, 900);
+		bool exported = ExportImage(image, argv[2]);
+		UnloadImage(image);
+		simd_viewer_free(&sv);
+		return exported ? 0 : 1;
+	}
+
+	// --listen <socket> shows the records streamed by an instrumented process as they arrive,
+	// --stream <socket> is such a process
+	if (argc == 3 && strcmp(argv[1], "--listen") == 0)
+		return listen_viewer(argv[2]);
+	if (argc == 3 && strcmp(argv[1], "--stream") == 0)
+		return stream_examples(argv[2]);
+
+	// --attach <pid> shows the vector registers of a running process, no instrumentation needed
+	if (argc == 3 && strcmp(argv[1], "--attach") == 0)
+		return attach_viewer(atoi(argv[2]));
+
+	// --bench [cache] measures every intrinsic the bench knows on this machine
+	if ((argc == 2 || argc == 3) && strcmp(argv[1], "--bench") == 0)
+		return bench_intrinsics((argc == 3) ? argv[2] : BENCH_CACHE_PATH);
+
+	Font font = {0};
+	InitWindow(1600, 900, "Intrinsics");
+	SetWindowState(FLAG_WINDOW_RESIZABLE);
+	SetTargetFPS(60);
+	//SetExitKey(KEY_NULL);
+
+	SimdViewer sv = { 0 };
+	simd_viewer_init(&sv);
+
+	SimdBench bench;
+	simd_bench_init(&bench, BENCH_CACHE_PATH);
+
+	// Lanes of shuffles are coloured by the lane they come from
+	simd_viewer_show_flow(&sv, true);
+
+	// The examples are recorded once and redrawn from the command buffer every frame
+	simd_viewer_set_retained(&sv, true);
+	record_examples(&sv);
+
+	// Nothing animates, frames are only produced on input or resize
+	simd_viewer_set_idle(&sv, true);
+
+	// Left and right arrows step through the pushes, the timeline at the bottom scrubs frames
+	simd_viewer_enable_history(&sv, true);
+
+	while (!WindowShouldClose())
+	{
+		// F1 shows the latest debug events, F2 prints all of them
+		if (IsKeyPressed(KEY_F1))
+			simd_viewer_show_debug_overlay(&sv, !sv.show_debug_overlay);
+		if (IsKeyPressed(KEY_F2))
+			simd_viewer_dump_debug_events(&sv, stdout);
+
+		// F4 shows the latency and throughput of the intrinsics on the banners
+		if (IsKeyPressed(KEY_F4))
+			simd_viewer_set_bench(&sv, sv.bench ? 0 : &bench);
+
+		// F5 toggles the lane colours of shuffles
+		if (IsKeyPressed(KEY_F5))
+			simd_viewer_show_flow(&sv, !sv.show_flow);
+
+		// F3 shows what each step of the examples costs, they're pushed again every frame meanwhile
+		if (IsKeyPressed(KEY_F3))
 		{
-			// Examples, uncomment to see
-			simd_unpack(&sv);
-			//simd_compare(&sv);
-			//simd_average(&sv);
-			//simd_movehdup(&sv);
-			//simd_compare_string(&sv);
-			simd_add_float256(&sv);
-			//simd_add_int128(&sv);
-			//simd_add_float128(&sv);
+			bool timing = !sv.timing_enabled;
+			simd_viewer_enable_timing(&sv, timing);
+			simd_viewer_set_retained(&sv, !timing);
+			simd_viewer_set_idle(&sv, !timing);
+			simd_viewer_clear(&sv);
+			if (!timing)
+				record_examples(&sv);
 		}
 
+		BeginDrawing();
+
+		ClearBackground(BACKGROUND_COLOR);
+
+		if (sv.timing_enabled)
+			record_examples(&sv);
 		simd_viewer_flush(&sv);
 
 		EndDrawing();
 	}
 
+	// The font and render target go before the GL context
+	simd_viewer_free(&sv);
 	CloseWindow();
+	simd_bench_free(&bench);
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+
+// An acquire load only orders what comes after it, a release store only what comes before it.
+// The fences order plain accesses on the other side too, as seqlocks need. On x86, which keeps
+// loads and stores in order, MSVC only has to fence the compiler.
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMD_THREAD_LOCAL __declspec(thread)
+static inline uint64_t simd_atomic_fetch_add_u64(uint64_t* p, uint64_t v) { return (uint64_t)_InterlockedExchangeAdd64((volatile int64_t*)p, (int64_t)v); }
+static inline uint32_t simd_atomic_fetch_add_u32(uint32_t* p, uint32_t v) { return (uint32_t)_InterlockedExchangeAdd((volatile long*)p, (long)v); }
+static inline uint64_t simd_atomic_load_acquire_u64(uint64_t* p) { uint64_t v = *(volatile uint64_t*)p; _ReadWriteBarrier(); return v; }
+static inline void     simd_atomic_store_release_u64(uint64_t* p, uint64_t v) { _ReadWriteBarrier(); *(volatile uint64_t*)p = v; }
+static inline void*    simd_atomic_load_acquire_ptr(void** p) { void* v = *(void* volatile*)p; _ReadWriteBarrier(); return v; }
+static inline int      simd_atomic_cas_ptr(void** p, void* expected, void* desired) { return _InterlockedCompareExchangePointer((void* volatile*)p, desired, expected) == expected; }
+static inline void     simd_atomic_fence_acquire(void) { _ReadWriteBarrier(); }
+static inline void     simd_atomic_fence_release(void) { _ReadWriteBarrier(); }
+#else
+#define SIMD_THREAD_LOCAL __thread
+static inline uint64_t simd_atomic_fetch_add_u64(uint64_t* p, uint64_t v) { return __atomic_fetch_add(p, v, __ATOMIC_RELAXED); }
+static inline uint32_t simd_atomic_fetch_add_u32(uint32_t* p, uint32_t v) { return __atomic_fetch_add(p, v, __ATOMIC_RELAXED); }
+static inline uint64_t simd_atomic_load_acquire_u64(uint64_t* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline void     simd_atomic_store_release_u64(uint64_t* p, uint64_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+static inline void*    simd_atomic_load_acquire_ptr(void** p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline int      simd_atomic_cas_ptr(void** p, void* expected, void* desired) { return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED); }
+static inline void     simd_atomic_fence_acquire(void) { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+static inline void     simd_atomic_fence_release(void) { __atomic_thread_fence(__ATOMIC_RELEASE); }
+#endif
@@ -0,0 +1,420 @@
+#if defined(__linux__)
+#define _GNU_SOURCE  // sched_getcpu and the affinity calls
+#endif
+#include "simd_bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+#include <light_array.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#if defined(__linux__)
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+// Unoptimized kernels keep their registers on the stack and measure the loads and stores, so the
+// file is optimized in debug builds too. Clang has no such pragma, build it with -O1 or more there.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("O2")
+#elif defined(_MSC_VER)
+#pragma optimize("gt", on)
+#endif
+
+#define ARRAY_LENGTH(A) (sizeof(A) / sizeof(*(A)))
+#define function static
+
+#define ITERATIONS 1000
+#define LATENCY_UNROLL 8
+#define THROUGHPUT_ROUNDS 2
+#define WARMUP_TICKS 20000000ull
+
+// Keeps the compiler from folding a chain into fewer instructions, emits nothing
+#if defined(_MSC_VER)
+#define OPAQUE(x) ((void)0)
+#define OPAQUE_SCALAR(x) ((void)0)
+#else
+#define OPAQUE(x) __asm__ volatile("" : "+v"(x))
+#define OPAQUE_SCALAR(x) __asm__ volatile("" : "+r"(x))
+#endif
+
+#define REPEAT8(S) S S S S S S S S
+#define CHAIN_STEP(OP, x) x = OP(x, y); OPAQUE(x);
+#define CHAIN_STEPS(OP) \
+	CHAIN_STEP(OP, x0) CHAIN_STEP(OP, x1) CHAIN_STEP(OP, x2) CHAIN_STEP(OP, x3) CHAIN_STEP(OP, x4) CHAIN_STEP(OP, x5) \
+	CHAIN_STEP(OP, x6) CHAIN_STEP(OP, x7) CHAIN_STEP(OP, x8) CHAIN_STEP(OP, x9) CHAIN_STEP(OP, x10) CHAIN_STEP(OP, x11)
+
+// Read at run time, so the inputs aren't constants either
+static volatile int32_t bench_seed = 1;
+static volatile uint8_t bench_sink;
+
+function inline uint64_t
+begin_ticks(void)
+{
+	_mm_lfence();
+	uint64_t ticks = __rdtsc();
+	_mm_lfence();
+	return ticks;
+}
+
+function inline uint64_t
+end_ticks(void)
+{
+	unsigned int processor;
+	uint64_t ticks = __rdtscp(&processor);
+	_mm_lfence();
+	return ticks;
+}
+
+// Each timed kernel returns the ticks of iterations * LATENCY_UNROLL dependent instructions, or
+// iterations * THROUGHPUT_ROUNDS * SIMD_BENCH_CHAINS independent ones
+#define BENCH_KERNELS(id, vector, init, OP)                                   \
+	function uint64_t                                                         \
+	id##_latency(uint32_t iterations)                                         \
+	{                                                                         \
+		vector y = init;                                                      \
+		vector x = y;                                                         \
+		uint64_t start = begin_ticks();                                       \
+		for (uint32_t i = 0; i < iterations; ++i)                             \
+		{                                                                     \
+			REPEAT8(x = OP(x, y); OPAQUE(x);)                                 \
+		}                                                                     \
+		uint64_t ticks = end_ticks() - start;                                 \
+		bench_sink = *(uint8_t*)&x;                                           \
+		return ticks;                                                         \
+	}                                                                         \
+                                                                              \
+	function uint64_t                                                         \
+	id##_throughput(uint32_t iterations)                                      \
+	{                                                                         \
+		vector y = init;                                                      \
+		vector x0 = y, x1 = y, x2 = y, x3 = y, x4 = y, x5 = y;                \
+		vector x6 = y, x7 = y, x8 = y, x9 = y, x10 = y, x11 = y;              \
+		uint64_t start = begin_ticks();                                       \
+		for (uint32_t i = 0; i < iterations; ++i)                             \
+		{                                                                     \
+			CHAIN_STEPS(OP)                                                   \
+			CHAIN_STEPS(OP)                                                   \
+		}                                                                     \
+		uint64_t ticks = end_ticks() - start;                                 \
+		bench_sink = *(uint8_t*)&x0 ^ *(uint8_t*)&x11;                        \
+		return ticks;                                                         \
+	}
+
+// Intrinsics that don't take two registers of their result type, adapted so they do
+function inline __m256 fmadd_ps256(__m256 a, __m256 b) { return _mm256_fmadd_ps(a, b, b); }
+function inline __m512i mask_add_epi32_512(__m512i a, __m512i b) { return _mm512_mask_add_epi32(a, 0x5555, a, b); }
+
+BENCH_KERNELS(mm_add_epi32, __m128i, _mm_set1_epi32(bench_seed), _mm_add_epi32)
+BENCH_KERNELS(mm_add_ps, __m128, _mm_set1_ps((float)bench_seed), _mm_add_ps)
+BENCH_KERNELS(mm256_add_epi32, __m256i, _mm256_set1_epi32(bench_seed), _mm256_add_epi32)
+BENCH_KERNELS(mm256_mullo_epi32, __m256i, _mm256_set1_epi32(bench_seed), _mm256_mullo_epi32)
+BENCH_KERNELS(mm256_cmpeq_epi64, __m256i, _mm256_set1_epi64x(bench_seed), _mm256_cmpeq_epi64)
+BENCH_KERNELS(mm256_unpacklo_epi8, __m256i, _mm256_set1_epi8((char)bench_seed), _mm256_unpacklo_epi8)
+BENCH_KERNELS(mm256_unpackhi_epi8, __m256i, _mm256_set1_epi8((char)bench_seed), _mm256_unpackhi_epi8)
+BENCH_KERNELS(mm256_shuffle_epi8, __m256i, _mm256_set1_epi8((char)bench_seed), _mm256_shuffle_epi8)
+BENCH_KERNELS(mm256_permutevar8x32_epi32, __m256i, _mm256_set1_epi32(bench_seed), _mm256_permutevar8x32_epi32)
+BENCH_KERNELS(mm256_avg_epu8, __m256i, _mm256_set1_epi8((char)bench_seed), _mm256_avg_epu8)
+BENCH_KERNELS(mm256_avg_epu16, __m256i, _mm256_set1_epi16((short)bench_seed), _mm256_avg_epu16)
+BENCH_KERNELS(mm256_add_ps, __m256, _mm256_set1_ps((float)bench_seed), _mm256_add_ps)
+BENCH_KERNELS(mm256_mul_ps, __m256, _mm256_set1_ps((float)bench_seed), _mm256_mul_ps)
+BENCH_KERNELS(mm256_fmadd_ps, __m256, _mm256_set1_ps((float)bench_seed), fmadd_ps256)
+BENCH_KERNELS(mm256_add_pd, __m256d, _mm256_set1_pd((double)bench_seed), _mm256_add_pd)
+BENCH_KERNELS(mm512_add_epi32, __m512i, _mm512_set1_epi32(bench_seed), _mm512_add_epi32)
+BENCH_KERNELS(mm512_mask_add_epi32, __m512i, _mm512_set1_epi32(bench_seed), mask_add_epi32_512)
+BENCH_KERNELS(mm512_shuffle_epi8, __m512i, _mm512_set1_epi8((char)bench_seed), _mm512_shuffle_epi8)
+BENCH_KERNELS(mm512_permutexvar_epi32, __m512i, _mm512_set1_epi32(bench_seed), _mm512_permutexvar_epi32)
+
+typedef struct {
+	const char* name;
+	uint64_t  (*latency)(uint32_t iterations);
+	uint64_t  (*throughput)(uint32_t iterations);
+} BenchIntrinsic;
+
+#define BENCH_INTRINSIC(id) { "_" #id, id##_latency, id##_throughput }
+
+static const BenchIntrinsic bench_intrinsics[] = {
+	BENCH_INTRINSIC(mm_add_epi32),
+	BENCH_INTRINSIC(mm_add_ps),
+	BENCH_INTRINSIC(mm256_add_epi32),
+	BENCH_INTRINSIC(mm256_mullo_epi32),
+	BENCH_INTRINSIC(mm256_cmpeq_epi64),
+	BENCH_INTRINSIC(mm256_unpacklo_epi8),
+	BENCH_INTRINSIC(mm256_unpackhi_epi8),
+	BENCH_INTRINSIC(mm256_shuffle_epi8),
+	BENCH_INTRINSIC(mm256_permutevar8x32_epi32),
+	BENCH_INTRINSIC(mm256_avg_epu8),
+	BENCH_INTRINSIC(mm256_avg_epu16),
+	BENCH_INTRINSIC(mm256_add_ps),
+	BENCH_INTRINSIC(mm256_mul_ps),
+	BENCH_INTRINSIC(mm256_fmadd_ps),
+	BENCH_INTRINSIC(mm256_add_pd),
+	BENCH_INTRINSIC(mm512_add_epi32),
+	BENCH_INTRINSIC(mm512_mask_add_epi32),
+	BENCH_INTRINSIC(mm512_shuffle_epi8),
+	BENCH_INTRINSIC(mm512_permutexvar_epi32),
+};
+
+// One add per cycle whatever the clock, the ticks it takes give the TSC to core clock ratio
+function uint64_t
+scalar_add_chain(uint32_t iterations)
+{
+	uint64_t y = (uint64_t)bench_seed;
+	uint64_t x = y;
+	uint64_t start = begin_ticks();
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		REPEAT8(x += y; OPAQUE_SCALAR(x);)
+	}
+	uint64_t ticks = end_ticks() - start;
+	bench_sink = (uint8_t)x;
+	return ticks;
+}
+
+// ----------------------------------------------------------------------------------------------
+// Machine
+
+#if defined(__linux__)
+typedef cpu_set_t Affinity;
+
+function void
+pin_thread(Affinity* previous)
+{
+	sched_getaffinity(0, sizeof(*previous), previous);
+	cpu_set_t pinned;
+	CPU_ZERO(&pinned);
+	CPU_SET(sched_getcpu(), &pinned);
+	sched_setaffinity(0, sizeof(pinned), &pinned);
+}
+
+function void
+unpin_thread(Affinity* previous)
+{
+	sched_setaffinity(0, sizeof(*previous), previous);
+}
+#elif defined(_WIN32)
+typedef DWORD_PTR Affinity;
+
+function void
+pin_thread(Affinity* previous)
+{
+	*previous = SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << GetCurrentProcessorNumber());
+}
+
+function void
+unpin_thread(Affinity* previous)
+{
+	if (*previous)
+		SetThreadAffinityMask(GetCurrentThread(), *previous);
+}
+#else
+typedef int Affinity;
+function void pin_thread(Affinity* previous) { (void)previous; }
+function void unpin_thread(Affinity* previous) { (void)previous; }
+#endif
+
+function void
+cpu_brand(char* brand)
+{
+	uint32_t registers[12] = { 0 };
+	uint32_t highest;
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0x80000000);
+	highest = (uint32_t)info[0];
+	for (uint32_t i = 0; i < 3 && highest >= 0x80000004; ++i)
+		__cpuid((int*)registers + i * 4, 0x80000002 + i);
+#else
+	highest = __get_cpuid_max(0x80000000, 0);
+	for (uint32_t i = 0; i < 3 && highest >= 0x80000004; ++i)
+		__get_cpuid(0x80000002 + i, &registers[i * 4], &registers[i * 4 + 1], &registers[i * 4 + 2], &registers[i * 4 + 3]);
+#endif
+	if (highest < 0x80000004)
+	{
+		strcpy(brand, "unknown");
+		return;
+	}
+
+	// Some brand strings are padded with leading spaces
+	char text[49] = { 0 };
+	memcpy(text, registers, 48);
+	const char* start = text;
+	while (*start == ' ')
+		start++;
+	strcpy(brand, start);
+}
+
+// ----------------------------------------------------------------------------------------------
+// Measurement
+
+function int
+compare_u64(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+function double
+median_ticks(uint64_t (*kernel)(uint32_t iterations))
+{
+	uint64_t ticks[SIMD_BENCH_RUNS];
+	for (uint32_t i = 0; i < SIMD_BENCH_RUNS; ++i)
+		ticks[i] = kernel(ITERATIONS);
+	qsort(ticks, SIMD_BENCH_RUNS, sizeof(*ticks), compare_u64);
+	return (double)ticks[SIMD_BENCH_RUNS / 2];
+}
+
+// Wide units that sat unused run slower until they power up, and the clock takes a while to ramp up
+function void
+warm_up(const BenchIntrinsic* intrinsic)
+{
+	uint64_t start = __rdtsc();
+	while (__rdtsc() - start < WARMUP_TICKS)
+		intrinsic->throughput(ITERATIONS / 10);
+}
+
+function SimdBenchResult
+measure(SimdBench* bench, const BenchIntrinsic* intrinsic)
+{
+	Affinity previous;
+	pin_thread(&previous);
+	warm_up(intrinsic);
+	double tsc_per_cycle = median_ticks(scalar_add_chain) / (ITERATIONS * LATENCY_UNROLL);
+	double latency = median_ticks(intrinsic->latency) / (ITERATIONS * LATENCY_UNROLL);
+	double throughput = median_ticks(intrinsic->throughput) / (ITERATIONS * THROUGHPUT_ROUNDS * SIMD_BENCH_CHAINS);
+	unpin_thread(&previous);
+
+	bench->tsc_per_cycle = tsc_per_cycle;
+	SimdBenchResult result = { intrinsic->name, (float)(latency / tsc_per_cycle), (float)(throughput / tsc_per_cycle) };
+	return result;
+}
+
+function const BenchIntrinsic*
+find_intrinsic(const char* name)
+{
+	for (uint32_t i = 0; i < ARRAY_LENGTH(bench_intrinsics); ++i)
+	{
+		if (strcmp(bench_intrinsics[i].name, name) == 0)
+			return &bench_intrinsics[i];
+	}
+	return 0;
+}
+
+function SimdBenchResult*
+find_result(SimdBench* bench, const char* name)
+{
+	for (uint32_t i = 0; i < array_length(bench->results); ++i)
+	{
+		if (strcmp(bench->results[i].name, name) == 0)
+			return &bench->results[i];
+	}
+	return 0;
+}
+
+// ----------------------------------------------------------------------------------------------
+// Cache
+
+// Lines of other CPUs and of intrinsics this build doesn't know are skipped, later lines win
+function void
+load_cache(SimdBench* bench)
+{
+	FILE* file = fopen(bench->path, "r");
+	if (!file)
+		return;
+
+	char line[512];
+	while (fgets(line, sizeof(line), file))
+	{
+		char* name = strchr(line, '\t');
+		char* values = name ? strchr(name + 1, '\t') : 0;
+		if (!values)
+			continue;
+		*name++ = 0;
+		*values++ = 0;
+
+		SimdBenchResult result;
+		const BenchIntrinsic* intrinsic = find_intrinsic(name);
+		if (strcmp(line, bench->cpu) != 0 || !intrinsic || sscanf(values, "%f %f", &result.latency, &result.throughput) != 2)
+			continue;
+		result.name = intrinsic->name;
+
+		SimdBenchResult* existing = find_result(bench, result.name);
+		if (existing)
+			*existing = result;
+		else
+			array_push(bench->results, result);
+	}
+	fclose(file);
+}
+
+function void
+append_cache(SimdBench* bench, const SimdBenchResult* result)
+{
+	if (!bench->path[0])
+		return;
+	FILE* file = fopen(bench->path, "a");
+	if (!file)
+		return;
+	fprintf(file, "%s\t%s\t%.2f\t%.3f\n", bench->cpu, result->name, result->latency, result->throughput);
+	fclose(file);
+}
+
+// ----------------------------------------------------------------------------------------------
+// Bench
+
+void
+simd_bench_init(SimdBench* bench, const char* cache_path)
+{
+	memset(bench, 0, sizeof(*bench));
+	cpu_brand(bench->cpu);
+	if (cache_path)
+		strncpy(bench->path, cache_path, sizeof(bench->path) - 1);
+	bench->results = array_new(SimdBenchResult);
+	if (bench->path[0])
+		load_cache(bench);
+}
+
+void
+simd_bench_free(SimdBench* bench)
+{
+	array_free(bench->results);
+	memset(bench, 0, sizeof(*bench));
+}
+
+bool
+simd_bench_get(SimdBench* bench, const char* name, SimdBenchResult* result)
+{
+	SimdBenchResult* known = find_result(bench, name);
+	if (known)
+	{
+		*result = *known;
+		return true;
+	}
+
+	const BenchIntrinsic* intrinsic = find_intrinsic(name);
+	if (!intrinsic)
+		return false;
+	*result = measure(bench, intrinsic);
+	array_push(bench->results, *result);
+	append_cache(bench, result);
+	return true;
+}
+
+uint32_t
+simd_bench_intrinsic_count(void)
+{
+	return ARRAY_LENGTH(bench_intrinsics);
+}
+
+const char*
+simd_bench_intrinsic_name(uint32_t index)
+{
+	return (index < ARRAY_LENGTH(bench_intrinsics)) ? bench_intrinsics[index].name : 0;
+}
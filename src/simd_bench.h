@@ -0,0 +1,42 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Latency and reciprocal throughput of the intrinsics the viewer knows, measured on this machine.
+// Latency runs the intrinsic in one dependent chain, throughput in SIMD_BENCH_CHAINS independent
+// ones. Each is pinned to the current core, warmed up, and the median of SIMD_BENCH_RUNS rdtsc
+// timed runs is taken. TSC ticks are turned into core cycles with a chain of scalar adds, which
+// take one cycle each.
+//
+// Results are appended to a text file, one line per intrinsic keyed by the CPUID brand string, so
+// one file can collect the numbers of several machines:
+//   cpu<TAB>intrinsic<TAB>latency<TAB>throughput
+
+#define SIMD_BENCH_CHAINS 12
+#define SIMD_BENCH_RUNS 31
+
+typedef struct {
+	const char* name;        // the intrinsic, as pushed with simd_viewer_push_operation
+	float       latency;     // core cycles from an input to the result
+	float       throughput;  // core cycles per instruction when nothing depends on the previous one
+} SimdBenchResult;
+
+typedef struct {
+	char cpu[49];    // brand string of the CPU the results are for
+	char path[260];  // cache file, empty to keep the results in memory only
+
+	SimdBenchResult* results;        // light_array, loaded or measured so far
+	double           tsc_per_cycle;  // 0 until calibrated
+} SimdBench;
+
+// Loads what the cache file holds for this CPU, a missing file is an empty cache. Path may be null.
+void simd_bench_init(SimdBench* bench, const char* cache_path);
+void simd_bench_free(SimdBench* bench);
+
+// Measures the intrinsic on the first call and appends it to the cache. False for names that
+// aren't in the table, only intrinsics whose result can feed their own input are.
+bool simd_bench_get(SimdBench* bench, const char* name, SimdBenchResult* result);
+
+// The intrinsics that can be measured
+uint32_t    simd_bench_intrinsic_count(void);
+const char* simd_bench_intrinsic_name(uint32_t index);
@@ -0,0 +1,420 @@
+#include "simd_capture.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <light_array.h>
+
+#define function static
+
+void
+simd_capture_init(SimdCaptureRing* ring, uint64_t capacity)
+{
+	assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "Capacity must be a power of two");
+	memset(ring, 0, sizeof(*ring));
+	ring->records = _mm_malloc(capacity * sizeof(SimdCaptureRecord), sizeof(__m512i));
+	ring->capacity = capacity;
+	// Touch every page up front, the first captures shouldn't take page faults
+	memset(ring->records, 0, capacity * sizeof(SimdCaptureRecord));
+}
+
+void
+simd_capture_free(SimdCaptureRing* ring)
+{
+	if (ring->triggers)
+	{
+		for (uint32_t i = 0; i < SIMD_CAPTURE_MAX_CALLSITES; ++i)
+			_mm_free(ring->triggers[i].reservoir);
+		free(ring->triggers);
+	}
+	_mm_free(ring->records);
+	memset(ring, 0, sizeof(*ring));
+}
+
+void
+simd_capture_reset(SimdCaptureRing* ring)
+{
+	ring->write_index = 0;
+	ring->read_index = 0;
+	ring->dropped = 0;
+	ring->held = 0;
+}
+
+uint32_t
+simd_capture_callsite(SimdCaptureRing* ring, const char* name)
+{
+	for (uint32_t i = 0; i < ring->callsite_count; ++i)
+	{
+		if (strcmp(ring->callsites[i], name) == 0)
+			return i;
+	}
+	assert(ring->callsite_count < SIMD_CAPTURE_MAX_CALLSITES && "Too many callsites");
+	ring->callsites[ring->callsite_count] = name;
+	return ring->callsite_count++;
+}
+
+const char*
+simd_capture_callsite_name(const SimdCaptureRing* ring, uint32_t callsite)
+{
+	return (callsite < ring->callsite_count) ? ring->callsites[callsite] : "";
+}
+
+// ----------------------------------------------------------------------------------------------
+// Triggers
+
+void
+simd_capture_set_trigger(SimdCaptureRing* ring, uint32_t callsite, SimdCaptureTrigger trigger)
+{
+	assert(callsite < SIMD_CAPTURE_MAX_CALLSITES);
+	assert((trigger.sampling == SIMD_CAPTURE_SAMPLE_ALL || trigger.n > 0) && "Sampling needs n");
+	if (!ring->triggers)
+		ring->triggers = calloc(SIMD_CAPTURE_MAX_CALLSITES, sizeof(SimdCaptureTrigger));
+
+	SimdCaptureTrigger* slot = &ring->triggers[callsite];
+	if (slot->sampling == SIMD_CAPTURE_SAMPLE_RESERVOIR)
+		ring->reservoir_callsites--;
+	_mm_free(slot->reservoir);
+	*slot = trigger;
+	slot->hits = 0;
+	slot->random = 0x9e3779b97f4a7c15ull ^ callsite;
+	slot->reservoir = 0;
+	slot->reservoir_count = 0;
+	if (trigger.sampling == SIMD_CAPTURE_SAMPLE_RESERVOIR)
+	{
+		slot->reservoir = _mm_malloc(trigger.n * sizeof(SimdCaptureRecord), sizeof(__m512i));
+		ring->reservoir_callsites++;
+	}
+
+	// The last reservoir is gone, nothing is left to merge into what was held back
+	if (!ring->reservoir_callsites && ring->held)
+	{
+		simd_atomic_store_release_u64(&ring->write_index, ring->write_index + ring->held);
+		ring->held = 0;
+	}
+}
+
+// Lanes of the record the predicate holds for, one compare over the whole register
+function uint64_t
+predicate_lanes(const SimdCaptureTrigger* trigger, const SimdCaptureRecord* record)
+{
+	uint32_t size = record->register_size_bytes;
+	__m512i reg = _mm512_maskz_loadu_epi8((size >= 64) ? ~0ull : (1ull << size) - 1, record->bytes);
+
+	uint64_t lanes = 0;
+	uint32_t width = simd_capture_lane_size((RegisterType)record->type);
+	if (trigger->predicate == SIMD_CAPTURE_PREDICATE_ANY_NAN)
+	{
+		if (record->type == REGISTER_TYPE_F32)
+			lanes = _mm512_cmp_ps_mask(_mm512_castsi512_ps(reg), _mm512_castsi512_ps(reg), _CMP_UNORD_Q);
+		else if (record->type == REGISTER_TYPE_F64)
+			lanes = _mm512_cmp_pd_mask(_mm512_castsi512_pd(reg), _mm512_castsi512_pd(reg), _CMP_UNORD_Q);
+	}
+	else if (trigger->predicate == SIMD_CAPTURE_PREDICATE_LANE_EQUALS)
+	{
+		switch (width)
+		{
+			case 1: lanes = _mm512_cmpeq_epi8_mask(reg, _mm512_set1_epi8((char)trigger->value)); break;
+			case 2: lanes = _mm512_cmpeq_epi16_mask(reg, _mm512_set1_epi16((short)trigger->value)); break;
+			case 4: lanes = _mm512_cmpeq_epi32_mask(reg, _mm512_set1_epi32((int)trigger->value)); break;
+			case 8: lanes = _mm512_cmpeq_epi64_mask(reg, _mm512_set1_epi64((long long)trigger->value)); break;
+		}
+		if (trigger->lane >= 0)
+			lanes &= (trigger->lane < 64) ? 1ull << trigger->lane : 0;
+	}
+
+	// Lanes past the register and lanes masked off when captured don't count
+	uint32_t lane_count = size / width;
+	if (lane_count < 64)
+		lanes &= (1ull << lane_count) - 1;
+	return lanes & record->lane_mask;
+}
+
+bool
+simd_capture_trigger_end(SimdCaptureRing* ring, SimdCaptureRecord* record)
+{
+	SimdCaptureTrigger* trigger = &ring->triggers[record->callsite];
+	if (trigger->predicate != SIMD_CAPTURE_PREDICATE_NONE)
+	{
+		if (record->kind != SIMD_CAPTURE_REGISTER || !predicate_lanes(trigger, record))
+			return false;
+		if (!simd_capture_sample(trigger))
+			return false;
+	}
+	if (trigger->sampling != SIMD_CAPTURE_SAMPLE_RESERVOIR)
+		return true;
+
+	// Algorithm R, the kth call replaces a random sample with probability n/k
+	uint64_t seen = trigger->hits++;
+	uint64_t slot = seen;
+	if (seen >= trigger->n)
+	{
+		trigger->random ^= trigger->random << 13;
+		trigger->random ^= trigger->random >> 7;
+		trigger->random ^= trigger->random << 17;
+		slot = trigger->random % (seen + 1);
+		if (slot >= trigger->n)
+			return false;
+	}
+	else
+	{
+		trigger->reservoir_count++;
+	}
+	trigger->reservoir[slot] = *record;
+	return false;
+}
+
+function int
+compare_timestamp(const void* a, const void* b)
+{
+	uint64_t x = (*(const SimdCaptureRecord**)a)->timestamp;
+	uint64_t y = (*(const SimdCaptureRecord**)b)->timestamp;
+	return (x > y) - (x < y);
+}
+
+void
+simd_capture_flush_reservoirs(SimdCaptureRing* ring)
+{
+	if (!ring->triggers)
+		return;
+
+	uint64_t count = 0;
+	for (uint32_t i = 0; i < ring->callsite_count; ++i)
+		count += ring->triggers[i].reservoir_count;
+	if (count == 0 && ring->held == 0)
+		return;
+
+	const SimdCaptureRecord** samples = malloc((count ? count : 1) * sizeof(*samples));
+	uint64_t at = 0;
+	for (uint32_t i = 0; i < ring->callsite_count; ++i)
+	{
+		SimdCaptureTrigger* trigger = &ring->triggers[i];
+		for (uint64_t j = 0; j < trigger->reservoir_count; ++j)
+			samples[at++] = &trigger->reservoir[j];
+	}
+	qsort(samples, count, sizeof(*samples), compare_timestamp);
+
+	// The held captures are in timestamp order already, a wrapped ring only kept the newest of them
+	uint64_t mask = ring->capacity - 1;
+	uint64_t held = (ring->held < ring->capacity) ? ring->held : ring->capacity;
+	uint64_t start = ring->write_index + ring->held - held;
+	uint64_t total = held + count;
+	SimdCaptureRecord* merged = malloc(total * sizeof(SimdCaptureRecord));
+	uint64_t h = 0, s = 0;
+	for (uint64_t i = 0; i < total; ++i)
+	{
+		if (s == count || (h < held && ring->records[(start + h) & mask].timestamp <= samples[s]->timestamp))
+			merged[i] = ring->records[(start + h++) & mask];
+		else
+			merged[i] = *samples[s++];
+	}
+	free(samples);
+
+	// Spsc rings drop what doesn't fit like any capture, the others keep the newest as they wrap
+	uint64_t room = ring->spsc ? ring->capacity - (ring->write_index - simd_atomic_load_acquire_u64(&ring->read_index)) : ring->capacity;
+	uint64_t first = 0, last = total;
+	if (total > room && ring->spsc)
+	{
+		ring->dropped += total - room;
+		last = room;
+	}
+	else if (total > room)
+	{
+		first = total - room;
+	}
+	for (uint64_t i = first; i < last; ++i)
+		ring->records[(start + i - first) & mask] = merged[i];
+	free(merged);
+	ring->held = 0;
+	simd_atomic_store_release_u64(&ring->write_index, start + last - first);
+
+	for (uint32_t i = 0; i < ring->callsite_count; ++i)
+	{
+		if (ring->triggers[i].sampling != SIMD_CAPTURE_SAMPLE_RESERVOIR)
+			continue;
+		ring->triggers[i].hits = 0;
+		ring->triggers[i].reservoir_count = 0;
+	}
+}
+
+bool
+simd_capture_append(SimdCaptureRing* ring, const SimdCaptureRecord* record)
+{
+	uint64_t index = ring->write_index + ring->held;
+	if (ring->spsc && index - simd_atomic_load_acquire_u64(&ring->read_index) >= ring->capacity)
+	{
+		ring->dropped++;
+		return false;
+	}
+	ring->records[index & (ring->capacity - 1)] = *record;
+	if (ring->reservoir_callsites)
+		ring->held++;
+	else
+		simd_atomic_store_release_u64(&ring->write_index, index + 1);
+	return true;
+}
+
+uint64_t
+simd_capture_count(const SimdCaptureRing* ring)
+{
+	uint64_t count = ring->write_index - ring->read_index;
+	return (count < ring->capacity) ? count : ring->capacity;
+}
+
+const SimdCaptureRecord*
+simd_capture_at(const SimdCaptureRing* ring, uint64_t index)
+{
+	uint64_t first = ring->write_index - simd_capture_count(ring);
+	return &ring->records[(first + index) & (ring->capacity - 1)];
+}
+
+// ----------------------------------------------------------------------------------------------
+// Threads
+
+static SIMD_THREAD_LOCAL SimdCaptureCollector* thread_collector;
+static SIMD_THREAD_LOCAL uint64_t              thread_generation;
+static SIMD_THREAD_LOCAL SimdCaptureRing*      thread_ring;
+
+static uint64_t collector_generations;
+
+void
+simd_capture_collector_init(SimdCaptureCollector* collector, uint64_t ring_capacity)
+{
+	memset(collector, 0, sizeof(*collector));
+	collector->ring_capacity = ring_capacity;
+	collector->generation = simd_atomic_fetch_add_u64(&collector_generations, 1) + 1;
+}
+
+void
+simd_capture_collector_free(SimdCaptureCollector* collector)
+{
+	SimdCaptureThread* thread = collector->threads;
+	while (thread)
+	{
+		SimdCaptureThread* next = thread->next;
+		simd_capture_free(&thread->ring);
+		free(thread);
+		thread = next;
+	}
+	memset(collector, 0, sizeof(*collector));
+}
+
+SimdCaptureRing*
+simd_capture_thread_ring(SimdCaptureCollector* collector)
+{
+	if (thread_collector == collector && thread_generation == collector->generation)
+		return thread_ring;
+
+	SimdCaptureThread* thread = calloc(1, sizeof(SimdCaptureThread));
+	simd_capture_init(&thread->ring, collector->ring_capacity);
+	thread->ring.spsc = 1;
+	thread->ring.thread = (uint16_t)(simd_atomic_fetch_add_u32(&collector->thread_count, 1) + 1);
+
+	do {
+		thread->next = simd_atomic_load_acquire_ptr((void**)&collector->threads);
+	} while (!simd_atomic_cas_ptr((void**)&collector->threads, thread->next, thread));
+
+	thread_collector = collector;
+	thread_generation = collector->generation;
+	thread_ring = &thread->ring;
+	return thread_ring;
+}
+
+typedef struct {
+	SimdCaptureRing* ring;
+	uint64_t         read;
+	uint64_t         end;
+} CollectCursor;
+
+uint64_t
+simd_capture_collect(SimdCaptureCollector* collector, SimdCaptureEmit* emit, void* user)
+{
+	// Snapshot how far every ring was written, anything captured after this waits for the next collect
+	uint32_t cursor_count = 0;
+	for (SimdCaptureThread* thread = simd_atomic_load_acquire_ptr((void**)&collector->threads); thread; thread = thread->next)
+		cursor_count++;
+
+	CollectCursor* cursors = malloc((cursor_count ? cursor_count : 1) * sizeof(CollectCursor));
+	uint32_t c = 0;
+	for (SimdCaptureThread* thread = simd_atomic_load_acquire_ptr((void**)&collector->threads); thread && c < cursor_count; thread = thread->next)
+	{
+		cursors[c].ring = &thread->ring;
+		cursors[c].read = thread->ring.read_index;
+		cursors[c].end = simd_atomic_load_acquire_u64(&thread->ring.write_index);
+		c++;
+	}
+
+	// k-way merge, there are only ever a handful of threads so a linear scan beats a heap
+	uint64_t emitted = 0;
+	for (;;)
+	{
+		CollectCursor* oldest = 0;
+		const SimdCaptureRecord* oldest_record = 0;
+		for (uint32_t i = 0; i < cursor_count; ++i)
+		{
+			CollectCursor* cursor = &cursors[i];
+			if (cursor->read == cursor->end)
+				continue;
+			const SimdCaptureRecord* record = &cursor->ring->records[cursor->read & (cursor->ring->capacity - 1)];
+			if (!oldest || record->timestamp < oldest_record->timestamp)
+			{
+				oldest = cursor;
+				oldest_record = record;
+			}
+		}
+		if (!oldest)
+			break;
+
+		emit(user, oldest->ring, oldest_record);
+		oldest->read++;
+		emitted++;
+	}
+
+	// Hand the slots back to the producers
+	for (uint32_t i = 0; i < cursor_count; ++i)
+		simd_atomic_store_release_u64(&cursors[i].ring->read_index, cursors[i].read);
+
+	free(cursors);
+	return emitted;
+}
+
+uint32_t
+simd_capture_remap(SimdCaptureRemap** remaps, const SimdCaptureRing* ring, uint32_t callsite, SimdCaptureLookup* lookup, void* user)
+{
+	if (callsite >= ring->callsite_count)
+		return lookup(user, "");
+
+	// There are only ever a handful of rings
+	SimdCaptureRemap* remap = 0;
+	for (uint64_t i = 0; i < array_length(*remaps) && !remap; ++i)
+	{
+		if ((*remaps)[i].ring == ring)
+			remap = &(*remaps)[i];
+	}
+	if (!remap)
+	{
+		array_push(*remaps, ((SimdCaptureRemap) { ring, array_new(const char*), array_new(uint32_t) }));
+		remap = &(*remaps)[array_length(*remaps) - 1];
+	}
+
+	while (array_length(remap->ids) <= callsite)
+	{
+		array_push(remap->names, 0);
+		array_push(remap->ids, 0);
+	}
+	const char* name = ring->callsites[callsite];
+	if (remap->names[callsite] != name)
+	{
+		remap->names[callsite] = name;
+		remap->ids[callsite] = lookup(user, name);
+	}
+	return remap->ids[callsite];
+}
+
+void
+simd_capture_remap_free(SimdCaptureRemap* remaps)
+{
+	for (uint64_t i = 0; i < array_length(remaps); ++i)
+	{
+		array_free(remaps[i].names);
+		array_free(remaps[i].ids);
+	}
+	array_free(remaps);
+}
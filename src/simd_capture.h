@@ -0,0 +1,345 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include "simd_register.h"
+#include "simd_atomic.h"
+
+// Capture only copies the register into a preallocated ring, nothing is decoded, formatted or
+// drawn until the viewer replays it. Safe to leave in kernels that run under load.
+
+#define SIMD_CAPTURE_MAX_CALLSITES 1024
+
+typedef enum {
+	SIMD_CAPTURE_REGISTER,
+	SIMD_CAPTURE_OPERATION,  // banner named after the callsite
+} SimdCaptureKind;
+
+// Two cache lines, the register bytes sit on the second so a zmm copy never splits
+typedef struct {
+	uint64_t timestamp;  // rdtsc
+	uint64_t lane_mask;  // opmask of masked captures, all ones otherwise
+	uint32_t callsite;
+	uint16_t register_size_bytes;
+	uint8_t  type;       // RegisterType
+	uint8_t  kind;       // SimdCaptureKind
+	uint8_t  masked;
+	uint8_t  reserved0;
+	uint16_t thread;     // collector thread id, 0 for rings that aren't registered with one
+	uint8_t  reserved[36];
+	uint8_t  bytes[64];
+} SimdCaptureRecord;
+
+// Triggers keep loops that run billions of times down to the captures worth looking at.
+// The predicate filters first, the sampling then counts only the calls that passed it.
+typedef enum {
+	SIMD_CAPTURE_SAMPLE_ALL,
+	SIMD_CAPTURE_SAMPLE_EVERY_NTH,  // calls 0, n, 2n...
+	SIMD_CAPTURE_SAMPLE_FIRST_N,
+	SIMD_CAPTURE_SAMPLE_RESERVOIR,  // n uniformly chosen calls, kept aside until simd_capture_flush_reservoirs
+} SimdCaptureSampling;
+
+typedef enum {
+	SIMD_CAPTURE_PREDICATE_NONE,
+	SIMD_CAPTURE_PREDICATE_ANY_NAN,      // any f32 or f64 lane is NaN
+	SIMD_CAPTURE_PREDICATE_LANE_EQUALS,  // lane (or any lane if -1) equals value at the lane width of the type
+} SimdCapturePredicate;
+
+typedef struct {
+	SimdCaptureSampling  sampling;
+	SimdCapturePredicate predicate;
+	int32_t              lane;
+	uint64_t             value;
+	uint64_t             n;
+
+	uint64_t           hits;       // calls that passed the predicate
+	uint64_t           random;     // reservoir xorshift state
+	SimdCaptureRecord* reservoir;  // n records
+	uint64_t           reservoir_count;
+} SimdCaptureTrigger;
+
+typedef struct {
+	SimdCaptureRecord* records;   // 64 byte aligned
+	uint64_t           capacity;  // power of two
+	uint64_t           write_index;
+
+	// Single producer single consumer rings never overwrite, a full ring drops the capture
+	// into the scratch record instead so the producer never waits
+	uint64_t          read_index;
+	uint64_t          dropped;
+	uint16_t          thread;
+	uint8_t           spsc;
+	SimdCaptureRecord scratch;
+
+	const char* callsites[SIMD_CAPTURE_MAX_CALLSITES];
+	uint32_t    callsite_count;
+
+	SimdCaptureTrigger* triggers;  // one per callsite, null until the first trigger is set
+	// Captures a predicate or reservoir still has to decide on are written here, a slot of the
+	// ring would already hold the oldest record once it wrapped
+	SimdCaptureRecord   staged;
+	// While any callsite samples into a reservoir, captures are written past write_index but held
+	// back, so the samples can still be merged in among them by timestamp
+	uint32_t            reservoir_callsites;
+	uint64_t            held;
+} SimdCaptureRing;
+
+void simd_capture_init(SimdCaptureRing* ring, uint64_t capacity);
+void simd_capture_free(SimdCaptureRing* ring);
+void simd_capture_reset(SimdCaptureRing* ring);
+
+// Register the name once outside the hot loop and capture with the returned id, the name isn't copied
+uint32_t    simd_capture_callsite(SimdCaptureRing* ring, const char* name);
+const char* simd_capture_callsite_name(const SimdCaptureRing* ring, uint32_t callsite);
+
+// Replaces the trigger of the callsite, counters start over. A zeroed trigger captures every call.
+void simd_capture_set_trigger(SimdCaptureRing* ring, uint32_t callsite, SimdCaptureTrigger trigger);
+// Merges the reservoir samples in among the captures held back since the last flush, by timestamp,
+// publishes them all and starts new reservoirs. Call it from the capturing thread, between the
+// loops the reservoirs sample, consumers see nothing the ring captured in between until then.
+void simd_capture_flush_reservoirs(SimdCaptureRing* ring);
+
+// Out of line part of the triggers, the register has been copied into the staged record.
+// True if it goes into the ring.
+bool simd_capture_trigger_end(SimdCaptureRing* ring, SimdCaptureRecord* record);
+
+// Copies a finished record in as is, triggers don't apply. False if a full spsc ring dropped it.
+bool simd_capture_append(SimdCaptureRing* ring, const SimdCaptureRecord* record);
+
+// Records still in the ring, oldest first
+uint64_t                 simd_capture_count(const SimdCaptureRing* ring);
+const SimdCaptureRecord* simd_capture_at(const SimdCaptureRing* ring, uint64_t index);
+
+// Sampling without a predicate is decided before the register is even read
+static inline bool
+simd_capture_sample(SimdCaptureTrigger* trigger)
+{
+	switch (trigger->sampling)
+	{
+		case SIMD_CAPTURE_SAMPLE_EVERY_NTH: return trigger->hits++ % trigger->n == 0;
+		case SIMD_CAPTURE_SAMPLE_FIRST_N:   return trigger->hits++ < trigger->n;
+		default: return true;
+	}
+}
+
+static inline uint32_t
+simd_capture_lane_size(RegisterType type)
+{
+	switch (type)
+	{
+		case REGISTER_TYPE_S16: case REGISTER_TYPE_U16: return 2;
+		case REGISTER_TYPE_S32: case REGISTER_TYPE_U32: case REGISTER_TYPE_F32: return 4;
+		case REGISTER_TYPE_S64: case REGISTER_TYPE_U64: case REGISTER_TYPE_F64: return 8;
+		default: return 1;
+	}
+}
+
+// Records read back from traces or sockets aren't trusted, replaying relies on these
+static inline bool
+simd_capture_record_valid(const SimdCaptureRecord* record)
+{
+	return record->kind <= SIMD_CAPTURE_OPERATION && record->type <= REGISTER_TYPE_F64 &&
+		record->register_size_bytes <= sizeof(record->bytes);
+}
+
+// Null when the trigger skips the call
+static inline SimdCaptureRecord*
+simd_capture_begin(SimdCaptureRing* ring, SimdCaptureKind kind, uint32_t callsite, RegisterType type, uint32_t register_size_bytes)
+{
+	SimdCaptureRecord* record;
+	SimdCaptureTrigger* trigger = ring->triggers ? &ring->triggers[callsite] : 0;
+	if (trigger && trigger->predicate == SIMD_CAPTURE_PREDICATE_NONE && !simd_capture_sample(trigger))
+		return 0;
+
+	if (trigger && (trigger->predicate != SIMD_CAPTURE_PREDICATE_NONE || trigger->sampling == SIMD_CAPTURE_SAMPLE_RESERVOIR))
+	{
+		record = &ring->staged;
+	}
+	else
+	{
+		// Only the producer writes write_index
+		uint64_t index = ring->write_index + ring->held;
+		record = &ring->records[index & (ring->capacity - 1)];
+		if (ring->spsc && index - simd_atomic_load_acquire_u64(&ring->read_index) >= ring->capacity)
+			record = &ring->scratch;
+	}
+	record->timestamp = __rdtsc();
+	record->lane_mask = ~0ull;
+	record->callsite = callsite;
+	record->register_size_bytes = (uint16_t)register_size_bytes;
+	record->type = (uint8_t)type;
+	record->kind = (uint8_t)kind;
+	record->masked = 0;
+	record->thread = ring->thread;
+	return record;
+}
+
+// Publishes the record to the consumer
+static inline void
+simd_capture_end(SimdCaptureRing* ring, SimdCaptureRecord* record)
+{
+	if (record == &ring->staged)
+	{
+		if (simd_capture_trigger_end(ring, record))
+			simd_capture_append(ring, record);
+		return;
+	}
+	if (record == &ring->scratch)
+		ring->dropped++;
+	else if (ring->reservoir_callsites)
+		ring->held++;
+	else
+		simd_atomic_store_release_u64(&ring->write_index, ring->write_index + 1);
+}
+
+static inline void
+simd_viewer_capture(SimdCaptureRing* ring, uint32_t callsite, __m256i reg, RegisterType regtype)
+{
+	SimdCaptureRecord* record = simd_capture_begin(ring, SIMD_CAPTURE_REGISTER, callsite, regtype, sizeof(reg));
+	if (!record)
+		return;
+	memcpy(record->bytes, &reg, sizeof(reg));
+	simd_capture_end(ring, record);
+}
+
+static inline void
+simd_viewer_capturef(SimdCaptureRing* ring, uint32_t callsite, __m256 reg, RegisterType regtype)
+{
+	SimdCaptureRecord* record = simd_capture_begin(ring, SIMD_CAPTURE_REGISTER, callsite, regtype, sizeof(reg));
+	if (!record)
+		return;
+	memcpy(record->bytes, &reg, sizeof(reg));
+	simd_capture_end(ring, record);
+}
+
+static inline void
+simd_viewer_captured(SimdCaptureRing* ring, uint32_t callsite, __m256d reg, RegisterType regtype)
+{
+	SimdCaptureRecord* record = simd_capture_begin(ring, SIMD_CAPTURE_REGISTER, callsite, regtype, sizeof(reg));
+	if (!record)
+		return;
+	memcpy(record->bytes, &reg, sizeof(reg));
+	simd_capture_end(ring, record);
+}
+
+static inline void
+simd_viewer_capture128(SimdCaptureRing* ring, uint32_t callsite, __m128i reg, RegisterType regtype)
+{
+	SimdCaptureRecord* record = simd_capture_begin(ring, SIMD_CAPTURE_REGISTER, callsite, regtype, sizeof(reg));
+	if (!record)
+		return;
+	memcpy(record->bytes, &reg, sizeof(reg));
+	simd_capture_end(ring, record);
+}
+
+static inline void
+simd_viewer_capture128f(SimdCaptureRing* ring, uint32_t callsite, __m128 reg, RegisterType regtype)
+{
+	SimdCaptureRecord* record = simd_capture_begin(ring, SIMD_CAPTURE_REGISTER, callsite, regtype, sizeof(reg));
+	if (!record)
+		return;
+	memcpy(record->bytes, &reg, sizeof(reg));
+	simd_capture_end(ring, record);
+}
+
+static inline void
+simd_viewer_capture512(SimdCaptureRing* ring, uint32_t callsite, __m512i reg, RegisterType regtype)
+{
+	SimdCaptureRecord* record = simd_capture_begin(ring, SIMD_CAPTURE_REGISTER, callsite, regtype, sizeof(reg));
+	if (!record)
+		return;
+	memcpy(record->bytes, &reg, sizeof(reg));
+	simd_capture_end(ring, record);
+}
+
+static inline void
+simd_viewer_capture512f(SimdCaptureRing* ring, uint32_t callsite, __m512 reg, RegisterType regtype)
+{
+	SimdCaptureRecord* record = simd_capture_begin(ring, SIMD_CAPTURE_REGISTER, callsite, regtype, sizeof(reg));
+	if (!record)
+		return;
+	memcpy(record->bytes, &reg, sizeof(reg));
+	simd_capture_end(ring, record);
+}
+
+static inline void
+simd_viewer_capture512d(SimdCaptureRing* ring, uint32_t callsite, __m512d reg, RegisterType regtype)
+{
+	SimdCaptureRecord* record = simd_capture_begin(ring, SIMD_CAPTURE_REGISTER, callsite, regtype, sizeof(reg));
+	if (!record)
+		return;
+	memcpy(record->bytes, &reg, sizeof(reg));
+	simd_capture_end(ring, record);
+}
+
+static inline void
+simd_viewer_capture512_masked(SimdCaptureRing* ring, uint32_t callsite, __m512i reg, __mmask64 mask, RegisterType regtype)
+{
+	SimdCaptureRecord* record = simd_capture_begin(ring, SIMD_CAPTURE_REGISTER, callsite, regtype, sizeof(reg));
+	if (!record)
+		return;
+	memcpy(record->bytes, &reg, sizeof(reg));
+	record->lane_mask = mask;
+	record->masked = 1;
+	simd_capture_end(ring, record);
+}
+
+// The banner text is the callsite name
+static inline void
+simd_viewer_capture_operation(SimdCaptureRing* ring, uint32_t callsite, RegisterType regtype)
+{
+	SimdCaptureRecord* record = simd_capture_begin(ring, SIMD_CAPTURE_OPERATION, callsite, regtype, 0);
+	if (record)
+		simd_capture_end(ring, record);
+}
+
+// ----------------------------------------------------------------------------------------------
+// Threads
+
+typedef struct SimdCaptureThread SimdCaptureThread;
+struct SimdCaptureThread {
+	SimdCaptureRing    ring;  // spsc, written by its thread and drained by the collector
+	SimdCaptureThread* next;
+};
+
+// Each capturing thread gets its own ring the first time it asks for one, the collector merges
+// the rings by timestamp. rdtsc is comparable across cores on CPUs with an invariant TSC.
+typedef struct {
+	SimdCaptureThread* threads;  // pushed without locking, never removed until the collector is freed
+	uint64_t           ring_capacity;
+	uint32_t           thread_count;
+	uint64_t           generation;  // tells a collector from a freed one that lived at the same address
+} SimdCaptureCollector;
+
+// The record's callsite is an id of the ring it came from
+typedef void SimdCaptureEmit(void* user, const SimdCaptureRing* ring, const SimdCaptureRecord* record);
+
+void simd_capture_collector_init(SimdCaptureCollector* collector, uint64_t ring_capacity);
+void simd_capture_collector_free(SimdCaptureCollector* collector);
+
+// Ring of the calling thread, registered with the collector on first use. One collector per thread.
+SimdCaptureRing* simd_capture_thread_ring(SimdCaptureCollector* collector);
+
+// Drains every thread ring, emitting what was captured so far in timestamp order. Only one
+// thread may collect at a time, captures keep running meanwhile. Records still being written
+// go to the next collect, so the order only holds within one collect. Returns the records emitted.
+uint64_t simd_capture_collect(SimdCaptureCollector* collector, SimdCaptureEmit* emit, void* user);
+
+// Callsite ids of one ring translated into the ids of a writer that merges several rings. Each
+// name is looked up once, later records only compare the name pointer, which also catches a
+// freed ring whose address was reused.
+typedef struct {
+	const SimdCaptureRing* ring;
+	const char**           names;  // light_array indexed by ring callsite, the name the id was looked up for
+	uint32_t*              ids;    // light_array indexed by ring callsite
+} SimdCaptureRemap;
+
+typedef uint32_t SimdCaptureLookup(void* user, const char* name);
+
+// remaps is a light_array, one entry per ring seen so far
+uint32_t simd_capture_remap(SimdCaptureRemap** remaps, const SimdCaptureRing* ring, uint32_t callsite, SimdCaptureLookup* lookup, void* user);
+void     simd_capture_remap_free(SimdCaptureRemap* remaps);
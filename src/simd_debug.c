@@ -0,0 +1,98 @@
+#include "simd_debug.h"
+#include "simd_atomic.h"
+#include <stdlib.h>
+
+#define function static
+
+SimdDebugRing*
+simd_debug_ring_create(void)
+{
+	return calloc(1, sizeof(SimdDebugRing));
+}
+
+void
+simd_debug_ring_destroy(SimdDebugRing* ring)
+{
+	free(ring);
+}
+
+void
+simd_debug_push(SimdDebugRing* ring, SimdDebugEventKind kind, uint64_t frame, int32_t a, int32_t b, uint64_t value)
+{
+	if (!ring)
+		return;
+
+	uint64_t index = simd_atomic_fetch_add_u64(&ring->write_index, 1);
+	SimdDebugEvent* event = &ring->events[index & (SIMD_DEBUG_RING_SIZE - 1)];
+
+	// Invalidate first so a reader never takes half of the old and half of the new event. The
+	// fence keeps the event's stores from moving above the invalidation.
+	simd_atomic_store_release_u64(&event->sequence, 0);
+	simd_atomic_fence_release();
+	event->frame = frame;
+	event->value = value;
+	event->a = a;
+	event->b = b;
+	event->kind = kind;
+	simd_atomic_store_release_u64(&event->sequence, index + 1);
+}
+
+uint32_t
+simd_debug_read(SimdDebugRing* ring, SimdDebugEvent* out, uint32_t max_count)
+{
+	if (!ring)
+		return 0;
+
+	uint64_t end = simd_atomic_load_acquire_u64(&ring->write_index);
+	uint64_t count = (end < SIMD_DEBUG_RING_SIZE) ? end : SIMD_DEBUG_RING_SIZE;
+	if (count > max_count)
+		count = max_count;
+
+	uint32_t copied = 0;
+	for (uint64_t index = end - count; index < end; ++index)
+	{
+		SimdDebugEvent* event = &ring->events[index & (SIMD_DEBUG_RING_SIZE - 1)];
+		if (simd_atomic_load_acquire_u64(&event->sequence) != index + 1)
+			continue;
+		out[copied] = *event;
+		// Overwritten while copying, the fence keeps the copy from moving below the check
+		simd_atomic_fence_acquire();
+		if (simd_atomic_load_acquire_u64(&event->sequence) != index + 1)
+			continue;
+		copied++;
+	}
+	return copied;
+}
+
+int
+simd_debug_format(const SimdDebugEvent* event, char* buffer, size_t size)
+{
+	switch (event->kind)
+	{
+		case SIMD_DEBUG_EVENT_HOVER_MATCH:
+			return snprintf(buffer, size, "[%llu] hover match row %d lane %d bits 0x%llx", (unsigned long long)event->frame, event->a, event->b, (unsigned long long)event->value);
+		case SIMD_DEBUG_EVENT_RELAYOUT:
+			return snprintf(buffer, size, "[%llu] relayout %d rows %d lanes", (unsigned long long)event->frame, event->a, event->b);
+		case SIMD_DEBUG_EVENT_REDRAW:
+			return snprintf(buffer, size, "[%llu] redraw %d rows view 0x%llx", (unsigned long long)event->frame, event->a, (unsigned long long)event->value);
+		default: break;
+	}
+	return snprintf(buffer, size, "[%llu] unknown event %d", (unsigned long long)event->frame, event->kind);
+}
+
+void
+simd_debug_dump(SimdDebugRing* ring, FILE* file)
+{
+	if (!ring)
+		return;
+
+	SimdDebugEvent* events = malloc(SIMD_DEBUG_RING_SIZE * sizeof(SimdDebugEvent));
+	uint32_t count = simd_debug_read(ring, events, SIMD_DEBUG_RING_SIZE);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		char line[128];
+		simd_debug_format(&events[i], line, sizeof(line));
+		fprintf(file, "%s\n", line);
+	}
+	free(events);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+// Power of two, older events are overwritten
+#define SIMD_DEBUG_RING_SIZE 1024
+
+typedef enum {
+	SIMD_DEBUG_EVENT_NONE = 0,
+	SIMD_DEBUG_EVENT_HOVER_MATCH,  // a = row, b = lane, value = lane bits
+	SIMD_DEBUG_EVENT_RELAYOUT,     // a = rows, b = indexed lanes
+	SIMD_DEBUG_EVENT_REDRAW,       // a = rows, value = view hash
+} SimdDebugEventKind;
+
+typedef struct {
+	uint64_t           sequence;  // index + 1 once the event is fully written, 0 while it is being written
+	uint64_t           frame;
+	uint64_t           value;
+	int32_t            a;
+	int32_t            b;
+	SimdDebugEventKind kind;
+} SimdDebugEvent;
+
+// Any thread can push without locking, readers skip slots that are being overwritten.
+// Pushing never touches stdio, events only leave memory through the read and dump calls.
+typedef struct {
+	uint64_t       write_index;
+	SimdDebugEvent events[SIMD_DEBUG_RING_SIZE];
+} SimdDebugRing;
+
+SimdDebugRing* simd_debug_ring_create(void);
+void           simd_debug_ring_destroy(SimdDebugRing* ring);
+
+void simd_debug_push(SimdDebugRing* ring, SimdDebugEventKind kind, uint64_t frame, int32_t a, int32_t b, uint64_t value);
+
+// Copies up to max_count of the most recent events, oldest first, and returns how many were copied
+uint32_t simd_debug_read(SimdDebugRing* ring, SimdDebugEvent* out, uint32_t max_count);
+
+int  simd_debug_format(const SimdDebugEvent* event, char* buffer, size_t size);
+void simd_debug_dump(SimdDebugRing* ring, FILE* file);
@@ -0,0 +1,218 @@
+#include "simd_flow.h"
+#include <string.h>
+#include <light_array.h>
+
+#define ARRAY_LENGTH(A) (sizeof(A) / sizeof(*(A)))
+#define function static
+
+typedef void FlowProbe(const __m512i* inputs, int32_t immediate, __m512i* result);
+
+typedef struct {
+	const char* name;
+	uint32_t    size;
+	uint32_t    input_count;
+	int32_t     control;
+	bool        immediate;  // the map depends on it, unknown without one
+	FlowProbe*  probe;
+} FlowIntrinsic;
+
+// Immediates have to be constants, every value gets its own case
+#define IMM4(CASE, i) CASE(i) CASE(i + 1) CASE(i + 2) CASE(i + 3)
+#define IMM16(CASE, i) IMM4(CASE, i) IMM4(CASE, i + 4) IMM4(CASE, i + 8) IMM4(CASE, i + 12)
+#define IMM256(CASE) \
+	IMM16(CASE, 0) IMM16(CASE, 16) IMM16(CASE, 32) IMM16(CASE, 48) IMM16(CASE, 64) IMM16(CASE, 80) IMM16(CASE, 96) IMM16(CASE, 112) \
+	IMM16(CASE, 128) IMM16(CASE, 144) IMM16(CASE, 160) IMM16(CASE, 176) IMM16(CASE, 192) IMM16(CASE, 208) IMM16(CASE, 224) IMM16(CASE, 240)
+
+// Registers of each width are kept in the low lanes of a zmm
+#define FROM_128(v) _mm512_castsi512_si128(v)
+#define FROM_256(v) _mm512_castsi512_si256(v)
+#define FROM_512(v) (v)
+#define TO_128(v) _mm512_castsi128_si512(v)
+#define TO_256(v) _mm512_castsi256_si512(v)
+#define TO_512(v) (v)
+
+#define PROBE_1(id, W, OP)                                                         \
+	function void                                                                  \
+	id(const __m512i* inputs, int32_t immediate, __m512i* result)                  \
+	{                                                                              \
+		(void)immediate;                                                           \
+		*result = TO_##W(OP(FROM_##W(inputs[0])));                                 \
+	}
+
+#define PROBE_2(id, W, OP)                                                         \
+	function void                                                                  \
+	id(const __m512i* inputs, int32_t immediate, __m512i* result)                  \
+	{                                                                              \
+		(void)immediate;                                                           \
+		*result = TO_##W(OP(FROM_##W(inputs[0]), FROM_##W(inputs[1])));            \
+	}
+
+// id##_CASE(i) is the call with immediate i
+#define PROBE_IMM(id)                                                              \
+	function void                                                                  \
+	id(const __m512i* inputs, int32_t immediate, __m512i* result)                  \
+	{                                                                              \
+		switch (immediate & 0xff)                                                  \
+		{                                                                          \
+			IMM256(id##_CASE)                                                      \
+		}                                                                          \
+	}
+#define PROBE_1_IMM_CASE(W, OP, i) case i: *result = TO_##W(OP(FROM_##W(inputs[0]), i)); break;
+#define PROBE_2_IMM_CASE(W, OP, i) case i: *result = TO_##W(OP(FROM_##W(inputs[0]), FROM_##W(inputs[1]), i)); break;
+
+// Float moves keep the bits, they're probed on integer registers
+function inline __m256i movehdup_256(__m256i a) { return _mm256_castps_si256(_mm256_movehdup_ps(_mm256_castsi256_ps(a))); }
+function inline __m256i moveldup_256(__m256i a) { return _mm256_castps_si256(_mm256_moveldup_ps(_mm256_castsi256_ps(a))); }
+
+PROBE_2(probe_mm_unpacklo_epi8, 128, _mm_unpacklo_epi8)
+PROBE_2(probe_mm_unpackhi_epi8, 128, _mm_unpackhi_epi8)
+PROBE_2(probe_mm_shuffle_epi8, 128, _mm_shuffle_epi8)
+PROBE_2(probe_mm256_unpacklo_epi8, 256, _mm256_unpacklo_epi8)
+PROBE_2(probe_mm256_unpackhi_epi8, 256, _mm256_unpackhi_epi8)
+PROBE_2(probe_mm256_unpacklo_epi16, 256, _mm256_unpacklo_epi16)
+PROBE_2(probe_mm256_unpackhi_epi16, 256, _mm256_unpackhi_epi16)
+PROBE_2(probe_mm256_unpacklo_epi32, 256, _mm256_unpacklo_epi32)
+PROBE_2(probe_mm256_unpackhi_epi32, 256, _mm256_unpackhi_epi32)
+PROBE_2(probe_mm256_unpacklo_epi64, 256, _mm256_unpacklo_epi64)
+PROBE_2(probe_mm256_unpackhi_epi64, 256, _mm256_unpackhi_epi64)
+PROBE_2(probe_mm256_shuffle_epi8, 256, _mm256_shuffle_epi8)
+PROBE_2(probe_mm256_permutevar8x32_epi32, 256, _mm256_permutevar8x32_epi32)
+PROBE_1(probe_mm256_movehdup_ps, 256, movehdup_256)
+PROBE_1(probe_mm256_moveldup_ps, 256, moveldup_256)
+PROBE_2(probe_mm512_unpacklo_epi8, 512, _mm512_unpacklo_epi8)
+PROBE_2(probe_mm512_unpackhi_epi8, 512, _mm512_unpackhi_epi8)
+PROBE_2(probe_mm512_shuffle_epi8, 512, _mm512_shuffle_epi8)
+PROBE_2(probe_mm512_permutexvar_epi32, 512, _mm512_permutexvar_epi32)
+
+#define probe_mm_shuffle_epi32_CASE(i) PROBE_1_IMM_CASE(128, _mm_shuffle_epi32, i)
+#define probe_mm256_shuffle_epi32_CASE(i) PROBE_1_IMM_CASE(256, _mm256_shuffle_epi32, i)
+#define probe_mm256_permute4x64_epi64_CASE(i) PROBE_1_IMM_CASE(256, _mm256_permute4x64_epi64, i)
+#define probe_mm256_bslli_epi128_CASE(i) PROBE_1_IMM_CASE(256, _mm256_bslli_epi128, i)
+#define probe_mm256_bsrli_epi128_CASE(i) PROBE_1_IMM_CASE(256, _mm256_bsrli_epi128, i)
+#define probe_mm_alignr_epi8_CASE(i) PROBE_2_IMM_CASE(128, _mm_alignr_epi8, i)
+#define probe_mm256_alignr_epi8_CASE(i) PROBE_2_IMM_CASE(256, _mm256_alignr_epi8, i)
+#define probe_mm256_blend_epi32_CASE(i) PROBE_2_IMM_CASE(256, _mm256_blend_epi32, i)
+#define probe_mm256_permute2x128_si256_CASE(i) PROBE_2_IMM_CASE(256, _mm256_permute2x128_si256, i)
+
+PROBE_IMM(probe_mm_shuffle_epi32)
+PROBE_IMM(probe_mm256_shuffle_epi32)
+PROBE_IMM(probe_mm256_permute4x64_epi64)
+PROBE_IMM(probe_mm256_bslli_epi128)
+PROBE_IMM(probe_mm256_bsrli_epi128)
+PROBE_IMM(probe_mm_alignr_epi8)
+PROBE_IMM(probe_mm256_alignr_epi8)
+PROBE_IMM(probe_mm256_blend_epi32)
+PROBE_IMM(probe_mm256_permute2x128_si256)
+
+#define FLOW_INTRINSIC(id, size, inputs, control) { "_" #id, size, inputs, control, false, probe_##id }
+#define FLOW_INTRINSIC_IMM(id, size, inputs) { "_" #id, size, inputs, -1, true, probe_##id }
+
+static const FlowIntrinsic flow_intrinsics[] = {
+	FLOW_INTRINSIC(mm_unpacklo_epi8, 16, 2, -1),
+	FLOW_INTRINSIC(mm_unpackhi_epi8, 16, 2, -1),
+	FLOW_INTRINSIC(mm_shuffle_epi8, 16, 2, 1),
+	FLOW_INTRINSIC_IMM(mm_shuffle_epi32, 16, 1),
+	FLOW_INTRINSIC_IMM(mm_alignr_epi8, 16, 2),
+	FLOW_INTRINSIC(mm256_unpacklo_epi8, 32, 2, -1),
+	FLOW_INTRINSIC(mm256_unpackhi_epi8, 32, 2, -1),
+	FLOW_INTRINSIC(mm256_unpacklo_epi16, 32, 2, -1),
+	FLOW_INTRINSIC(mm256_unpackhi_epi16, 32, 2, -1),
+	FLOW_INTRINSIC(mm256_unpacklo_epi32, 32, 2, -1),
+	FLOW_INTRINSIC(mm256_unpackhi_epi32, 32, 2, -1),
+	FLOW_INTRINSIC(mm256_unpacklo_epi64, 32, 2, -1),
+	FLOW_INTRINSIC(mm256_unpackhi_epi64, 32, 2, -1),
+	FLOW_INTRINSIC(mm256_shuffle_epi8, 32, 2, 1),
+	FLOW_INTRINSIC(mm256_permutevar8x32_epi32, 32, 2, 1),
+	FLOW_INTRINSIC(mm256_movehdup_ps, 32, 1, -1),
+	FLOW_INTRINSIC(mm256_moveldup_ps, 32, 1, -1),
+	FLOW_INTRINSIC_IMM(mm256_shuffle_epi32, 32, 1),
+	FLOW_INTRINSIC_IMM(mm256_permute4x64_epi64, 32, 1),
+	FLOW_INTRINSIC_IMM(mm256_bslli_epi128, 32, 1),
+	FLOW_INTRINSIC_IMM(mm256_bsrli_epi128, 32, 1),
+	FLOW_INTRINSIC_IMM(mm256_alignr_epi8, 32, 2),
+	FLOW_INTRINSIC_IMM(mm256_blend_epi32, 32, 2),
+	FLOW_INTRINSIC_IMM(mm256_permute2x128_si256, 32, 2),
+	FLOW_INTRINSIC(mm512_unpacklo_epi8, 64, 2, -1),
+	FLOW_INTRINSIC(mm512_unpackhi_epi8, 64, 2, -1),
+	FLOW_INTRINSIC(mm512_shuffle_epi8, 64, 2, 1),
+	FLOW_INTRINSIC(mm512_permutexvar_epi32, 64, 2, 0),
+};
+
+function const FlowIntrinsic*
+find_intrinsic(const char* name)
+{
+	for (uint32_t i = 0; i < ARRAY_LENGTH(flow_intrinsics); ++i)
+	{
+		if (strcmp(flow_intrinsics[i].name, name) == 0)
+			return &flow_intrinsics[i];
+	}
+	return 0;
+}
+
+function void
+probe(const FlowIntrinsic* intrinsic, int32_t immediate, const __m512i* operands, SimdFlowMap* map)
+{
+	__m512i tagged[SIMD_FLOW_MAX_INPUTS];
+	for (uint32_t k = 0; k < intrinsic->input_count; ++k)
+	{
+		uint8_t tags[64];
+		for (uint32_t j = 0; j < 64; ++j)
+			tags[j] = (uint8_t)(1 + 64 * k + j);
+		tagged[k] = ((int32_t)k == intrinsic->control) ? operands[k] : _mm512_loadu_si512(tags);
+	}
+
+	__m512i result;
+	intrinsic->probe(tagged, immediate, &result);
+	uint8_t bytes[64];
+	_mm512_storeu_si512(bytes, result);
+
+	memset(map, 0, sizeof(*map));
+	map->size = intrinsic->size;
+	map->input_count = intrinsic->input_count;
+	map->control = intrinsic->control;
+	for (uint32_t j = 0; j < intrinsic->size; ++j)
+		map->source[j] = bytes[j] ? (uint8_t)(bytes[j] - 1) : SIMD_FLOW_ZERO;
+}
+
+void
+simd_flow_cache_init(SimdFlowCache* cache)
+{
+	cache->entries = array_new(SimdFlowCacheEntry);
+}
+
+void
+simd_flow_cache_free(SimdFlowCache* cache)
+{
+	array_free(cache->entries);
+	cache->entries = 0;
+}
+
+bool
+simd_flow_get(SimdFlowCache* cache, const char* name, int32_t immediate, const __m512i* inputs, uint32_t input_count, SimdFlowMap* map)
+{
+	const FlowIntrinsic* intrinsic = find_intrinsic(name);
+	if (!intrinsic || input_count < intrinsic->input_count || intrinsic->immediate != (immediate >= 0))
+		return false;
+	const __m512i* operands = inputs + (input_count - intrinsic->input_count);
+
+	if (intrinsic->control >= 0)
+	{
+		probe(intrinsic, immediate, operands, map);
+		return true;
+	}
+
+	for (uint32_t i = 0; i < array_length(cache->entries); ++i)
+	{
+		if (cache->entries[i].name == intrinsic->name && cache->entries[i].immediate == immediate)
+		{
+			*map = cache->entries[i].map;
+			return true;
+		}
+	}
+
+	SimdFlowCacheEntry entry = { .name = intrinsic->name, .immediate = immediate };
+	probe(intrinsic, immediate, operands, &entry.map);
+	array_push(cache->entries, entry);
+	*map = entry.map;
+	return true;
+}
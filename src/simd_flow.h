@@ -0,0 +1,39 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+// Where each byte of a shuffle or permute result comes from, found by running the intrinsic on
+// tagged inputs: byte j of input k holds 1 + 64 * k + j, so every result byte names its source,
+// and 0 is a byte the intrinsic zeroed. Only intrinsics that move bytes without changing them are
+// in the table. The maps are cached per (intrinsic, immediate). Variable shuffles take their
+// control from the pushed register instead of a tag, so their map is probed again every time.
+
+#define SIMD_FLOW_MAX_INPUTS 3
+#define SIMD_FLOW_ZERO 0xff
+
+typedef struct {
+	uint8_t  source[64];    // per result byte, input << 6 | byte of that input, or SIMD_FLOW_ZERO
+	uint32_t size;          // bytes of the result
+	uint32_t input_count;   // register operands, pushed in this order before the operation banner
+	int32_t  control;       // operand that is a shuffle control rather than data, -1 if none
+} SimdFlowMap;
+
+typedef struct {
+	const char* name;  // the table's copy
+	int32_t     immediate;
+	SimdFlowMap map;
+} SimdFlowCacheEntry;
+
+typedef struct {
+	SimdFlowCacheEntry* entries;  // light_array
+} SimdFlowCache;
+
+void simd_flow_cache_init(SimdFlowCache* cache);
+void simd_flow_cache_free(SimdFlowCache* cache);
+
+// Map of the intrinsic with this immediate, -1 for intrinsics that take none. inputs are the
+// registers pushed before the banner, oldest first, the map's operands are the last input_count of
+// them. They're only read for the control operand. False for intrinsics not in the table, or
+// when fewer registers than operands were pushed.
+bool simd_flow_get(SimdFlowCache* cache, const char* name, int32_t immediate, const __m512i* inputs, uint32_t input_count, SimdFlowMap* map);
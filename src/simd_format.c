@@ -0,0 +1,210 @@
+#include "simd_format.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define function static
+
+// Digits are extracted 8 lanes at a time on 32 bit lanes, 8 and 16 bit lanes
+// are widened first so every integer type below 64 bits goes through the same path.
+#define FORMAT_LANES_PER_PASS 8
+#define FORMAT_MAX_DECIMAL_DIGITS 10
+#define FORMAT_MAX_HEX_DIGITS 8
+
+// x / 10 for unsigned 32 bit lanes, using the 0xCCCCCCCD reciprocal on even and odd lanes
+function inline __m256i
+div10_epu32(__m256i x)
+{
+	const __m256i magic = _mm256_set1_epi32((int)0xCCCCCCCD);
+	__m256i even = _mm256_srli_epi64(_mm256_mul_epu32(x, magic), 35);
+	__m256i odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), magic), 35);
+	return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+// Widens 8 lanes starting at 'first' to 32 bits, sign extending signed types like printf's promotion does
+function __m256i
+load_widened_epi32(const SimdLanes* lanes, RegisterType type, int first)
+{
+	switch (type)
+	{
+		case REGISTER_TYPE_S8:  return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)&lanes->s8[first]));
+		case REGISTER_TYPE_U8:  return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&lanes->u8[first]));
+		case REGISTER_TYPE_S16: return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&lanes->s16[first]));
+		case REGISTER_TYPE_U16: return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)&lanes->u16[first]));
+		case REGISTER_TYPE_S32:
+		case REGISTER_TYPE_U32: return _mm256_loadu_si256((const __m256i*)&lanes->u32[first]);
+		default: assert(false);
+	}
+	return _mm256_setzero_si256();
+}
+
+function void
+format_decimal_epi32(Light_Arena* arena, __m256i values, bool is_signed, int count, const char** out)
+{
+	__m256i negative = _mm256_setzero_si256();
+	if (is_signed)
+	{
+		negative = _mm256_cmpgt_epi32(_mm256_setzero_si256(), values);
+		values = _mm256_abs_epi32(values); // INT32_MIN stays 0x80000000, which is right when read unsigned
+	}
+
+	// digits[d] holds digit d (least significant first) of every lane, stored rather than read
+	// through the vector so the lanes aren't type punned
+	uint32_t digits[FORMAT_MAX_DECIMAL_DIGITS][FORMAT_LANES_PER_PASS];
+	int digit_count = 0;
+	const __m256i ten = _mm256_set1_epi32(10);
+	do
+	{
+		__m256i quotient = div10_epu32(values);
+		__m256i digit = _mm256_sub_epi32(values, _mm256_mullo_epi32(quotient, ten));
+		_mm256_storeu_si256((__m256i*)digits[digit_count++], _mm256_add_epi32(digit, _mm256_set1_epi32('0')));
+		values = quotient;
+	} while (!_mm256_testz_si256(values, values));
+
+	int signs = _mm256_movemask_ps(_mm256_castsi256_ps(negative));
+
+	for (int lane = 0; lane < count; ++lane)
+	{
+		int first = digit_count - 1;
+		while (first > 0 && digits[first][lane] == '0')
+			first--;
+
+		char* text = arena_alloc(arena, first + 3);
+		char* at = text;
+		if (signs & (1 << lane))
+			*at++ = '-';
+		for (int d = first; d >= 0; --d)
+			*at++ = (char)digits[d][lane];
+		*at = 0;
+		out[lane] = text;
+	}
+}
+
+function void
+format_hex_epi32(Light_Arena* arena, __m256i values, int count, const char** out)
+{
+	const __m256i table = _mm256_setr_epi8(
+		'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+		'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+	const __m256i nibble_mask = _mm256_set1_epi32(0xf);
+
+	__m256i digits[FORMAT_MAX_HEX_DIGITS];
+	int digit_count = 0;
+	do
+	{
+		__m256i nibble = _mm256_and_si256(values, nibble_mask);
+		digits[digit_count++] = _mm256_shuffle_epi8(table, nibble);
+		values = _mm256_srli_epi32(values, 4);
+	} while (digit_count < FORMAT_MAX_HEX_DIGITS && !_mm256_testz_si256(values, values));
+
+	for (int lane = 0; lane < count; ++lane)
+	{
+		int first = digit_count - 1;
+		while (first > 0 && ((const char*)&digits[first])[lane * sizeof(uint32_t)] == '0')
+			first--;
+
+		char* text = arena_alloc(arena, first + 4);
+		char* at = text;
+		*at++ = '0';
+		*at++ = 'x';
+		for (int d = first; d >= 0; --d)
+			*at++ = ((const char*)&digits[d])[lane * sizeof(uint32_t)];
+		*at = 0;
+		out[lane] = text;
+	}
+}
+
+function const char*
+format_u64(Light_Arena* arena, uint64_t value, bool negative, bool hex)
+{
+	char buffer[SIMD_FORMAT_MAX_INTEGER_TEXT];
+	char* at = buffer + sizeof(buffer);
+	*--at = 0;
+	do
+	{
+		if (hex)
+		{
+			*--at = "0123456789abcdef"[value & 0xf];
+			value >>= 4;
+		}
+		else
+		{
+			*--at = (char)('0' + value % 10);
+			value /= 10;
+		}
+	} while (value);
+
+	if (hex)
+	{
+		*--at = 'x';
+		*--at = '0';
+	}
+	else if (negative)
+	{
+		*--at = '-';
+	}
+
+	size_t length = buffer + sizeof(buffer) - at;
+	char* text = arena_alloc(arena, length);
+	memcpy(text, at, length);
+	return text;
+}
+
+function const char*
+format_float(Light_Arena* arena, double value)
+{
+	int length = snprintf(0, 0, "%f", value) + 1;
+	char* text = arena_alloc(arena, length);
+	snprintf(text, length, "%f", value);
+	return text;
+}
+
+void
+simd_format_lanes(Light_Arena* arena, const SimdLanes* lanes, RegisterType type, int lane_count, bool hex, const char** out)
+{
+	switch (type)
+	{
+		case REGISTER_TYPE_S8:  case REGISTER_TYPE_U8:
+		case REGISTER_TYPE_S16: case REGISTER_TYPE_U16:
+		case REGISTER_TYPE_S32: case REGISTER_TYPE_U32: {
+			bool is_signed = type == REGISTER_TYPE_S8 || type == REGISTER_TYPE_S16 || type == REGISTER_TYPE_S32;
+			for (int first = 0; first < lane_count; first += FORMAT_LANES_PER_PASS)
+			{
+				int count = (lane_count - first < FORMAT_LANES_PER_PASS) ? lane_count - first : FORMAT_LANES_PER_PASS;
+				__m256i values = load_widened_epi32(lanes, type, first);
+				if (hex)
+					format_hex_epi32(arena, values, count, out + first);
+				else
+					format_decimal_epi32(arena, values, is_signed, count, out + first);
+			}
+		} break;
+
+		// At most 8 lanes of 64 bits, not worth a vector path
+		case REGISTER_TYPE_S64: {
+			for (int i = 0; i < lane_count; ++i)
+			{
+				int64_t v = lanes->s64[i];
+				uint64_t magnitude = (v < 0 && !hex) ? 0 - (uint64_t)v : (uint64_t)v;
+				out[i] = format_u64(arena, magnitude, v < 0, hex);
+			}
+		} break;
+		case REGISTER_TYPE_U64: {
+			for (int i = 0; i < lane_count; ++i)
+				out[i] = format_u64(arena, lanes->u64[i], false, hex);
+		} break;
+
+		case REGISTER_TYPE_F32: {
+			for (int i = 0; i < lane_count; ++i)
+				out[i] = format_float(arena, lanes->f32[i]);
+		} break;
+		case REGISTER_TYPE_F64: {
+			for (int i = 0; i < lane_count; ++i)
+				out[i] = format_float(arena, lanes->f64[i]);
+		} break;
+
+		default: {
+			for (int i = 0; i < lane_count; ++i)
+				out[i] = "";
+		} break;
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <stdbool.h>
+#include "simd_register.h"
+#include "simd_utils.h"
+#include <light_arena.h>
+
+// Longest text a single lane can produce, "-9223372036854775808" plus terminator
+#define SIMD_FORMAT_MAX_INTEGER_TEXT 24
+
+// Formats every lane of the register in one pass, writing the strings into the arena.
+// out[i] receives the text of lane i, the arena owns the memory until it is cleared.
+void simd_format_lanes(Light_Arena* arena, const SimdLanes* lanes, RegisterType type, int lane_count, bool hex, const char** out);
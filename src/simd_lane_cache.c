@@ -0,0 +1,143 @@
+#include "simd_lane_cache.h"
+#include "simd_format.h"
+#include <assert.h>
+#include <string.h>
+
+#define function static
+
+function void
+lru_unlink(LaneCache* cache, int32_t index)
+{
+	LaneCacheSlot* slot = &cache->slots[index];
+	if (slot->prev >= 0) cache->slots[slot->prev].next = slot->next;
+	else cache->head = slot->next;
+	if (slot->next >= 0) cache->slots[slot->next].prev = slot->prev;
+	else cache->tail = slot->prev;
+	slot->prev = slot->next = -1;
+}
+
+function void
+lru_push_front(LaneCache* cache, int32_t index)
+{
+	LaneCacheSlot* slot = &cache->slots[index];
+	slot->prev = -1;
+	slot->next = cache->head;
+	if (cache->head >= 0) cache->slots[cache->head].prev = index;
+	cache->head = index;
+	if (cache->tail < 0) cache->tail = index;
+}
+
+function void
+table_create(LaneCache* cache)
+{
+	// Keys point into the slots, which never move, so the table doesn't copy them.
+	// Twice the capacity keeps the table under its occupancy limit so it never grows.
+	ht_new_sized(&cache->table, HTABLE_DONT_COPY_KEYS, sizeof(int64_t), (uint64_t)cache->capacity * 2);
+	cache->tombstones = 0;
+}
+
+// Evictions leave tombstones behind, rebuild from the live slots before they clog the probing
+function void
+table_rebuild(LaneCache* cache)
+{
+	ht_free(&cache->table);
+	table_create(cache);
+	for (int64_t i = cache->head; i >= 0; i = cache->slots[i].next)
+		ht_add(&cache->table, (const char*)&cache->slots[i].key, sizeof(LaneCacheKey), &i);
+}
+
+void
+lane_cache_init(LaneCache* cache, int32_t capacity)
+{
+	cache->capacity = capacity;
+	cache->count = 0;
+	cache->head = -1;
+	cache->tail = -1;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->slots = calloc(capacity, sizeof(LaneCacheSlot));
+	table_create(cache);
+}
+
+void
+lane_cache_free(LaneCache* cache)
+{
+	for (int32_t i = 0; i < cache->count; ++i)
+		free(cache->slots[i].text);
+	free(cache->slots);
+	ht_free(&cache->table);
+	cache->slots = 0;
+	cache->count = 0;
+	cache->head = cache->tail = -1;
+}
+
+const LaneCacheSlot*
+lane_cache_get(LaneCache* cache, Font font, const SimdLanes* lanes, RegisterType type, uint32_t register_size_bytes, bool hex, Light_Arena* scratch)
+{
+	LaneCacheKey key = { 0 };
+	memcpy(key.bytes, lanes->u8, register_size_bytes);
+	key.register_size_bytes = register_size_bytes;
+	key.type = type;
+	key.hex = hex;
+
+	int64_t* found = ht_get(&cache->table, (const char*)&key, sizeof(key));
+	if (found)
+	{
+		cache->hits++;
+		lru_unlink(cache, (int32_t)*found);
+		lru_push_front(cache, (int32_t)*found);
+		return &cache->slots[*found];
+	}
+	cache->misses++;
+
+	int64_t index;
+	if (cache->count < cache->capacity)
+	{
+		index = cache->count++;
+	}
+	else
+	{
+		index = cache->tail;
+		lru_unlink(cache, (int32_t)index);
+		ht_delete(&cache->table, (const char*)&cache->slots[index].key, sizeof(LaneCacheKey));
+		free(cache->slots[index].text);
+		if (++cache->tombstones > cache->table.table_size / 4)
+			table_rebuild(cache);
+	}
+
+	LaneCacheSlot* slot = &cache->slots[index];
+	slot->key = key;
+
+	int32_t lane_count = 0;
+	switch (type)
+	{
+		case REGISTER_TYPE_S8:  case REGISTER_TYPE_U8:  lane_count = register_size_bytes / sizeof(uint8_t); break;
+		case REGISTER_TYPE_S16: case REGISTER_TYPE_U16: lane_count = register_size_bytes / sizeof(uint16_t); break;
+		case REGISTER_TYPE_S32: case REGISTER_TYPE_U32: case REGISTER_TYPE_F32: lane_count = register_size_bytes / sizeof(uint32_t); break;
+		case REGISTER_TYPE_S64: case REGISTER_TYPE_U64: case REGISTER_TYPE_F64: lane_count = register_size_bytes / sizeof(uint64_t); break;
+		default: break;
+	}
+	slot->lane_count = lane_count;
+
+	const char* formatted[LANE_CACHE_MAX_LANES];
+	simd_format_lanes(scratch, lanes, type, lane_count, hex, formatted);
+
+	size_t total = 0;
+	for (int32_t i = 0; i < lane_count; ++i)
+		total += strlen(formatted[i]) + 1;
+
+	slot->text = malloc(total);
+	char* at = slot->text;
+	for (int32_t i = 0; i < lane_count; ++i)
+	{
+		size_t length = strlen(formatted[i]) + 1;
+		memcpy(at, formatted[i], length);
+		slot->lane_text[i] = at;
+		slot->lane_measure[i] = MeasureTextEx(font, at, (float)font.baseSize, 0);
+		at += length;
+	}
+
+	lru_push_front(cache, (int32_t)index);
+	ht_add(&cache->table, (const char*)&slot->key, sizeof(LaneCacheKey), &index);
+	return slot;
+}
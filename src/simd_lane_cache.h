@@ -0,0 +1,49 @@
+#pragma once
+#include <stdbool.h>
+#include <raylib.h>
+#include <hthash.h>
+#include <light_arena.h>
+#include "simd_register.h"
+#include "simd_utils.h"
+
+#define LANE_CACHE_DEFAULT_CAPACITY 1024
+#define LANE_CACHE_MAX_LANES sizeof(__m512i)
+
+typedef struct {
+	uint8_t      bytes[sizeof(__m512i)];  // zero padded past register_size_bytes
+	uint32_t     register_size_bytes;
+	RegisterType type;
+	uint32_t     hex;
+} LaneCacheKey;
+
+typedef struct {
+	LaneCacheKey key;
+
+	int32_t prev;  // LRU list, head is the most recently used
+	int32_t next;
+
+	int32_t     lane_count;
+	char*       text;  // every lane string back to back, owned by the slot
+	const char* lane_text[LANE_CACHE_MAX_LANES];
+	Vector2     lane_measure[LANE_CACHE_MAX_LANES];
+} LaneCacheSlot;
+
+typedef struct {
+	HtTable        table;  // LaneCacheKey -> int64_t slot index
+	LaneCacheSlot* slots;
+	int32_t        capacity;
+	int32_t        count;
+	int32_t        head;
+	int32_t        tail;
+	uint32_t       tombstones;
+
+	uint64_t hits;
+	uint64_t misses;
+} LaneCache;
+
+void lane_cache_init(LaneCache* cache, int32_t capacity);
+void lane_cache_free(LaneCache* cache);
+
+// Returns the formatted and measured lanes of the register, formatting them on a miss.
+// The scratch arena only holds temporaries, the slot stays valid until it is evicted.
+const LaneCacheSlot* lane_cache_get(LaneCache* cache, Font font, const SimdLanes* lanes, RegisterType type, uint32_t register_size_bytes, bool hex, Light_Arena* scratch);
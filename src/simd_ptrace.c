@@ -0,0 +1,196 @@
+#include "simd_ptrace.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__) && defined(__x86_64__)
+#include <cpuid.h>
+#include <elf.h>
+#include <errno.h>
+#include <immintrin.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#endif
+
+#define function static
+
+// XSAVE state components
+#define XSTATE_YMM       2
+#define XSTATE_OPMASK    5
+#define XSTATE_ZMM_HI256 6
+#define XSTATE_HI16_ZMM  7
+
+#define XSAVE_XMM_OFFSET    160
+#define XSAVE_HEADER_OFFSET 512
+
+#if defined(__linux__) && defined(__x86_64__)
+
+// Offset of the component in the standard layout, 0 when the OS doesn't enable it
+function uint32_t
+xstate_offset(uint32_t component, uint64_t enabled)
+{
+	if (!(enabled & (1ull << component)))
+		return 0;
+	uint32_t eax, ebx, ecx, edx;
+	__cpuid_count(0xd, component, eax, ebx, ecx, edx);
+	return ebx;
+}
+
+function void
+init_layout(SimdPtrace* trace)
+{
+	// CPUID leaf 0xd lists what the CPU supports, XCR0 what the OS enabled. xgetbv faults
+	// unless the OS turned on OSXSAVE.
+	uint32_t eax, ebx, ecx, edx;
+	__cpuid(1, eax, ebx, ecx, edx);
+	uint64_t enabled = (ecx & bit_OSXSAVE) ? _xgetbv(0) : 0;
+	__cpuid_count(0xd, 0, eax, ebx, ecx, edx);
+	trace->xstate_size = ebx;  // for the components enabled in XCR0
+	trace->xstate = calloc(1, trace->xstate_size);
+	trace->ymm_offset = xstate_offset(XSTATE_YMM, enabled);
+	trace->opmask_offset = xstate_offset(XSTATE_OPMASK, enabled);
+	trace->zmm_hi256_offset = xstate_offset(XSTATE_ZMM_HI256, enabled);
+	trace->hi16_zmm_offset = xstate_offset(XSTATE_HI16_ZMM, enabled);
+}
+
+bool
+simd_ptrace_attach(SimdPtrace* trace, int pid)
+{
+	memset(trace, 0, sizeof(*trace));
+	if (ptrace(PTRACE_SEIZE, pid, 0, 0) != 0)
+		return false;
+	trace->pid = pid;
+	trace->state = SIMD_PTRACE_RUNNING;
+	init_layout(trace);
+	simd_ptrace_stop(trace);
+	return true;
+}
+
+void
+simd_ptrace_detach(SimdPtrace* trace)
+{
+	if (trace->state == SIMD_PTRACE_RUNNING)
+	{
+		// Only a stopped tracee can be detached
+		simd_ptrace_stop(trace);
+		int status;
+		if (waitpid(trace->pid, &status, __WALL) == trace->pid && !WIFSTOPPED(status))
+			trace->state = SIMD_PTRACE_EXITED;
+	}
+	if (trace->state != SIMD_PTRACE_EXITED && trace->state != SIMD_PTRACE_DETACHED)
+		ptrace(PTRACE_DETACH, trace->pid, 0, 0);
+	free(trace->xstate);
+	memset(trace, 0, sizeof(*trace));
+}
+
+bool
+simd_ptrace_stop(SimdPtrace* trace)
+{
+	return trace->state == SIMD_PTRACE_RUNNING && ptrace(PTRACE_INTERRUPT, trace->pid, 0, 0) == 0;
+}
+
+bool
+simd_ptrace_continue(SimdPtrace* trace)
+{
+	if (trace->state != SIMD_PTRACE_STOPPED || ptrace(PTRACE_CONT, trace->pid, 0, 0) != 0)
+		return false;
+	trace->state = SIMD_PTRACE_RUNNING;
+	return true;
+}
+
+bool
+simd_ptrace_step(SimdPtrace* trace)
+{
+	if (trace->state != SIMD_PTRACE_STOPPED || ptrace(PTRACE_SINGLESTEP, trace->pid, 0, 0) != 0)
+		return false;
+	trace->state = SIMD_PTRACE_RUNNING;
+	return true;
+}
+
+bool
+simd_ptrace_poll(SimdPtrace* trace)
+{
+	if (trace->state != SIMD_PTRACE_RUNNING)
+		return false;
+
+	int status;
+	pid_t result = waitpid(trace->pid, &status, WNOHANG | __WALL);
+	if (result != trace->pid)
+		return false;
+	if (WIFEXITED(status) || WIFSIGNALED(status))
+	{
+		trace->state = SIMD_PTRACE_EXITED;
+		return true;
+	}
+	if (!WIFSTOPPED(status))
+		return false;
+
+	// Signals that aren't ours are passed on, the process keeps running as it would have
+	int signal = WSTOPSIG(status);
+	bool ours = signal == SIGTRAP || (status >> 16) == PTRACE_EVENT_STOP;
+	if (!ours)
+	{
+		ptrace(PTRACE_CONT, trace->pid, 0, (void*)(uintptr_t)signal);
+		return false;
+	}
+	trace->state = SIMD_PTRACE_STOPPED;
+	trace->stops++;
+	return true;
+}
+
+bool
+simd_ptrace_read(SimdPtrace* trace, SimdRegisterFile* registers)
+{
+	if (trace->state != SIMD_PTRACE_STOPPED)
+		return false;
+
+	struct iovec io = { trace->xstate, trace->xstate_size };
+	memset(trace->xstate, 0, trace->xstate_size);
+	if (ptrace(PTRACE_GETREGSET, trace->pid, (void*)NT_X86_XSTATE, &io) != 0)
+		return false;
+
+	struct user_regs_struct regs;
+	memset(registers, 0, sizeof(*registers));
+	if (ptrace(PTRACE_GETREGS, trace->pid, 0, &regs) == 0)
+		registers->rip = regs.rip;
+
+	// Components left in their init state are zero, XSTATE_BV says which ones were written
+	uint64_t written;
+	memcpy(&written, trace->xstate + XSAVE_HEADER_OFFSET, sizeof(written));
+	const uint8_t* xstate = trace->xstate;
+	bool has_ymm = trace->ymm_offset && (written & (1ull << XSTATE_YMM));
+	bool has_zmm = trace->zmm_hi256_offset && (written & (1ull << XSTATE_ZMM_HI256));
+	bool has_hi16 = trace->hi16_zmm_offset && (written & (1ull << XSTATE_HI16_ZMM));
+
+	registers->vector_count = trace->hi16_zmm_offset ? 32 : 16;
+	registers->vector_size = trace->zmm_hi256_offset ? 64 : trace->ymm_offset ? 32 : 16;
+	registers->mask_count = trace->opmask_offset ? 8 : 0;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		uint8_t* bytes = (uint8_t*)&registers->zmm[i];
+		memcpy(bytes, xstate + XSAVE_XMM_OFFSET + i * 16, 16);
+		if (has_ymm)
+			memcpy(bytes + 16, xstate + trace->ymm_offset + i * 16, 16);
+		if (has_zmm)
+			memcpy(bytes + 32, xstate + trace->zmm_hi256_offset + i * 32, 32);
+	}
+	if (has_hi16)
+		memcpy(&registers->zmm[16], xstate + trace->hi16_zmm_offset, 16 * 64);
+	if (trace->opmask_offset && (written & (1ull << XSTATE_OPMASK)))
+		memcpy(registers->k, xstate + trace->opmask_offset, sizeof(registers->k));
+	return true;
+}
+
+#else
+
+bool simd_ptrace_attach(SimdPtrace* trace, int pid) { memset(trace, 0, sizeof(*trace)); (void)pid; return false; }
+void simd_ptrace_detach(SimdPtrace* trace) { memset(trace, 0, sizeof(*trace)); }
+bool simd_ptrace_stop(SimdPtrace* trace) { (void)trace; return false; }
+bool simd_ptrace_continue(SimdPtrace* trace) { (void)trace; return false; }
+bool simd_ptrace_step(SimdPtrace* trace) { (void)trace; return false; }
+bool simd_ptrace_poll(SimdPtrace* trace) { (void)trace; return false; }
+bool simd_ptrace_read(SimdPtrace* trace, SimdRegisterFile* registers) { (void)trace; (void)registers; return false; }
+
+#endif
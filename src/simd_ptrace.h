@@ -0,0 +1,53 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+// Reads the vector register file of another process through ptrace, nothing has to be compiled
+// into it. The state comes from PTRACE_GETREGSET NT_X86_XSTATE, laid out as XSAVE's standard
+// format, with CPUID giving where the AVX, opmask and ZMM components are.
+// Linux only, elsewhere attaching fails.
+
+typedef struct {
+	__m512i  zmm[32];       // xmm and ymm are the low lanes, the rest is zero
+	uint64_t k[8];
+	uint32_t vector_count;  // 16, or 32 with AVX-512
+	uint32_t vector_size;   // bytes, 16 with SSE only, 32 with AVX, 64 with AVX-512
+	uint32_t mask_count;    // 8 with AVX-512
+	uint64_t rip;
+} SimdRegisterFile;
+
+typedef enum {
+	SIMD_PTRACE_DETACHED,
+	SIMD_PTRACE_RUNNING,
+	SIMD_PTRACE_STOPPED,
+	SIMD_PTRACE_EXITED,
+} SimdPtraceState;
+
+typedef struct {
+	int             pid;
+	SimdPtraceState state;
+	uint64_t        stops;  // counts every stop, the register file is only worth reading when it changes
+
+	uint8_t* xstate;
+	uint32_t xstate_size;
+	uint32_t ymm_offset;     // XSAVE component offsets, 0 if the CPU doesn't have it
+	uint32_t opmask_offset;
+	uint32_t zmm_hi256_offset;
+	uint32_t hi16_zmm_offset;
+} SimdPtrace;
+
+// Seizes the process and stops it
+bool simd_ptrace_attach(SimdPtrace* trace, int pid);
+// Lets the process run on untraced
+void simd_ptrace_detach(SimdPtrace* trace);
+
+// Stop, continue and step don't wait, poll notices the stop when it happens
+bool simd_ptrace_stop(SimdPtrace* trace);
+bool simd_ptrace_continue(SimdPtrace* trace);
+bool simd_ptrace_step(SimdPtrace* trace);
+// Checks for a stop or exit without blocking, true when the state changed
+bool simd_ptrace_poll(SimdPtrace* trace);
+
+// Only while stopped
+bool simd_ptrace_read(SimdPtrace* trace, SimdRegisterFile* registers);
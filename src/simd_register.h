@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include <immintrin.h>
+
+typedef enum {
+	REGISTER_TYPE_NONE,
+	
+	REGISTER_TYPE_S8,
+	REGISTER_TYPE_S16,
+	REGISTER_TYPE_S32,
+	REGISTER_TYPE_S64,
+
+	REGISTER_TYPE_U8,
+	REGISTER_TYPE_U16,
+	REGISTER_TYPE_U32,
+	REGISTER_TYPE_U64,
+
+	REGISTER_TYPE_F32,
+	REGISTER_TYPE_F64,
+} RegisterType;
+
+typedef enum {
+	FREGISTER_TYPE_NONE,
+	FREGISTER_TYPE_F32,
+	FREGISTER_TYPE_F64,
+} FRegisterType;
+
+typedef struct {
+	RegisterType type; // division type
+
+	uint32_t register_size_bytes;
+	uint64_t lane_mask; // opmask bit per lane, used with SIMD_VIEWER_RENDER_MASK
+	union {
+		uint8_t  u8val;
+		int8_t   s8val;
+		uint16_t u16val;
+		int16_t  s16val;
+		uint32_t u32val;
+		int32_t  s32val;
+		uint64_t u64val;
+		int64_t  s64val;
+		__m128i  i128;
+		__m128   f128;
+		__m128d  f128d;
+		__m256i  i256;
+		__m256   f256;
+		__m256d  f256d;
+		__m512i  i512;
+		__m512   f512;
+		__m512d  f512d;
+	};
+} AnyValue;
@@ -0,0 +1,147 @@
+#include "simd_software.h"
+#include <assert.h>
+#include <math.h>
+
+#define function static
+
+// Source over, coverage scales the alpha of the color
+function void
+blend_pixel(uint8_t* pixel, Color color, uint32_t coverage)
+{
+	uint32_t a = (color.a * coverage + 127) / 255;
+	uint32_t inv = 255 - a;
+	pixel[0] = (uint8_t)((color.r * a + pixel[0] * inv + 127) / 255);
+	pixel[1] = (uint8_t)((color.g * a + pixel[1] * inv + 127) / 255);
+	pixel[2] = (uint8_t)((color.b * a + pixel[2] * inv + 127) / 255);
+	pixel[3] = (uint8_t)(a + (pixel[3] * inv + 127) / 255);
+}
+
+function void
+fill_rect(Image* image, Rectangle rect, Color color)
+{
+	int x0 = (int)roundf(rect.x);
+	int y0 = (int)roundf(rect.y);
+	int x1 = (int)roundf(rect.x + rect.width);
+	int y1 = (int)roundf(rect.y + rect.height);
+	if (x0 < 0) x0 = 0;
+	if (y0 < 0) y0 = 0;
+	if (x1 > image->width) x1 = image->width;
+	if (y1 > image->height) y1 = image->height;
+
+	uint8_t* pixels = image->data;
+	for (int y = y0; y < y1; ++y)
+	{
+		uint8_t* pixel = pixels + ((size_t)y * image->width + x0) * 4;
+		if (color.a == 255)
+		{
+			for (int x = x0; x < x1; ++x, pixel += 4)
+				pixel[0] = color.r, pixel[1] = color.g, pixel[2] = color.b, pixel[3] = 255;
+		}
+		else
+		{
+			for (int x = x0; x < x1; ++x, pixel += 4)
+				blend_pixel(pixel, color, 255);
+		}
+	}
+}
+
+// Glyph images from LoadFontData hold coverage as grayscale
+function void
+draw_glyph(Image* image, const Image* glyph, int gx, int gy, Color color)
+{
+	if (!glyph->data)
+		return;
+	assert(glyph->format == PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
+
+	const uint8_t* coverage = glyph->data;
+	uint8_t* pixels = image->data;
+	for (int y = 0; y < glyph->height; ++y)
+	{
+		int py = gy + y;
+		if (py < 0 || py >= image->height)
+			continue;
+		for (int x = 0; x < glyph->width; ++x)
+		{
+			int px = gx + x;
+			uint8_t c = coverage[y * glyph->width + x];
+			if (px < 0 || px >= image->width || c == 0)
+				continue;
+			blend_pixel(pixels + ((size_t)py * image->width + px) * 4, color, c);
+		}
+	}
+}
+
+function void
+software_quads(SimdViewerBackend* backend, const BatchQuad* quads, size_t count)
+{
+	SimdSoftwareRenderer* renderer = (SimdSoftwareRenderer*)backend;
+	for (size_t i = 0; i < count; ++i)
+		fill_rect(renderer->image, quads[i].rect, quads[i].color);
+}
+
+// Same glyph placement as DrawTextEx at the base size with no spacing
+function void
+software_text(SimdViewerBackend* backend, Font font, const BatchText* texts, size_t count, Color color)
+{
+	SimdSoftwareRenderer* renderer = (SimdSoftwareRenderer*)backend;
+	if (!font.glyphs)
+		return;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		float x = texts[i].position.x;
+		int y = (int)roundf(texts[i].position.y);
+		for (const char* at = texts[i].text; *at;)
+		{
+			int size = 0;
+			int codepoint = GetCodepointNext(at, &size);
+			at += size;
+
+			int index = GetGlyphIndex(font, codepoint);
+			const GlyphInfo* glyph = &font.glyphs[index];
+			if (codepoint != ' ')
+				draw_glyph(renderer->image, &glyph->image, (int)roundf(x) + glyph->offsetX, y + glyph->offsetY, color);
+			x += (glyph->advanceX != 0) ? glyph->advanceX : font.recs[index].width + glyph->offsetX;
+		}
+	}
+}
+
+SimdSoftwareRenderer
+simd_software_renderer(Image* image)
+{
+	assert(image->format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+	SimdSoftwareRenderer renderer = {
+		.backend = { .quads = software_quads, .text = software_text },
+		.image = image,
+	};
+	return renderer;
+}
+
+Font
+simd_software_load_font(const char* filename, int font_size, int glyph_count)
+{
+	Font font = { 0 };
+	int data_size = 0;
+	unsigned char* data = LoadFileData(filename, &data_size);
+	if (!data)
+		return font;
+
+	font.baseSize = font_size;
+	font.glyphCount = glyph_count;
+	font.glyphPadding = 4;
+	font.glyphs = LoadFontData(data, data_size, font_size, 0, glyph_count, FONT_DEFAULT);
+	UnloadFileData(data);
+
+	// The atlas is only generated for the glyph rectangles MeasureTextEx reads
+	Image atlas = GenImageFontAtlas(font.glyphs, &font.recs, glyph_count, font_size, font.glyphPadding, 0);
+	UnloadImage(atlas);
+	return font;
+}
+
+void
+simd_software_unload_font(Font font)
+{
+	if (font.glyphs)
+		UnloadFontData(font.glyphs, font.glyphCount);
+	MemFree(font.recs);
+}
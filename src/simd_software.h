@@ -0,0 +1,14 @@
+#pragma once
+#include "simd_viewer.h"
+
+// CPU rasterizer for the viewer batches, renders into an R8G8B8A8 image without a GL context
+typedef struct {
+	SimdViewerBackend backend;  // first, the viewer only sees this
+	Image*            image;
+} SimdSoftwareRenderer;
+
+SimdSoftwareRenderer simd_software_renderer(Image* image);
+
+// Glyph images and metrics only, the font texture is never created
+Font simd_software_load_font(const char* filename, int font_size, int glyph_count);
+void simd_software_unload_font(Font font);
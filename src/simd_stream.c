@@ -0,0 +1,390 @@
+#include "simd_stream.h"
+#include <stdlib.h>
+#include <string.h>
+#include <light_array.h>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define function static
+
+// ----------------------------------------------------------------------------------------------
+// Socket
+
+#if !defined(_WIN32)
+
+function bool
+socket_address(const char* path, struct sockaddr_un* address)
+{
+	memset(address, 0, sizeof(*address));
+	address->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address->sun_path))
+		return false;
+	strcpy(address->sun_path, path);
+	return true;
+}
+
+function int
+socket_connect(const char* path)
+{
+	struct sockaddr_un address;
+	if (!socket_address(path, &address))
+		return -1;
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return -1;
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// 1 sent, 0 no room right now, -1 the viewer is gone
+function int
+socket_send(int fd, const void* data, size_t size)
+{
+	if (send(fd, data, size, MSG_DONTWAIT | MSG_NOSIGNAL) == (ssize_t)size)
+		return 1;
+	return (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) ? 0 : -1;
+}
+
+#else
+
+function int socket_connect(const char* path) { (void)path; return -1; }
+function int socket_send(int fd, const void* data, size_t size) { (void)fd; (void)data; (void)size; return -1; }
+
+#endif
+
+// ----------------------------------------------------------------------------------------------
+// Sender
+
+void
+simd_stream_sender_init(SimdStreamSender* sender, const char* path)
+{
+	memset(sender, 0, sizeof(*sender));
+	sender->socket = -1;
+	strncpy(sender->path, path, sizeof(sender->path) - 1);
+	sender->message = malloc(SIMD_STREAM_MESSAGE_MAX_SIZE);
+	sender->callsites = array_new(const char*);
+	sender->announced = array_new(uint8_t);
+	sender->remaps = array_new(SimdCaptureRemap);
+}
+
+function void
+sender_disconnect(SimdStreamSender* sender)
+{
+#if !defined(_WIN32)
+	if (sender->socket >= 0)
+		close(sender->socket);
+#endif
+	sender->socket = -1;
+	memset(sender->announced, 0, array_length(sender->announced));
+}
+
+void
+simd_stream_sender_free(SimdStreamSender* sender)
+{
+	simd_stream_flush(sender);
+	sender_disconnect(sender);
+	free(sender->message);
+	array_free(sender->callsites);
+	array_free(sender->announced);
+	simd_capture_remap_free(sender->remaps);
+	memset(sender, 0, sizeof(*sender));
+	sender->socket = -1;
+}
+
+function uint32_t
+sender_callsite(void* user, const char* name)
+{
+	SimdStreamSender* sender = user;
+	for (uint32_t i = 0; i < array_length(sender->callsites); ++i)
+	{
+		if (strcmp(sender->callsites[i], name) == 0)
+			return i;
+	}
+	array_push(sender->callsites, name);
+	array_push(sender->announced, 0);
+	return (uint32_t)array_length(sender->callsites) - 1;
+}
+
+// The viewer has to know the names before the batch that uses them
+function int
+announce_callsites(SimdStreamSender* sender)
+{
+	for (uint32_t i = 0; i < sender->batch_count; ++i)
+	{
+		uint32_t callsite = sender->batch[i].callsite;
+		if (sender->announced[callsite])
+			continue;
+
+		const char* name = sender->callsites[callsite];
+		uint32_t length = (uint32_t)strlen(name);
+		if (length > SIMD_STREAM_MESSAGE_MAX_SIZE - sizeof(SimdStreamMessage))
+			length = (uint32_t)(SIMD_STREAM_MESSAGE_MAX_SIZE - sizeof(SimdStreamMessage));
+		SimdStreamMessage header = { SIMD_STREAM_MAGIC, SIMD_STREAM_MESSAGE_CALLSITE, length, callsite, sender->dropped };
+		memcpy(sender->message, &header, sizeof(header));
+		memcpy(sender->message + sizeof(header), name, length);
+
+		int sent = socket_send(sender->socket, sender->message, sizeof(header) + length);
+		if (sent <= 0)
+			return sent;
+		sender->announced[callsite] = 1;
+	}
+	return 1;
+}
+
+void
+simd_stream_flush(SimdStreamSender* sender)
+{
+	if (sender->batch_count == 0)
+		return;
+
+	// Connecting to a local socket fails right away when nobody listens, so it's retried every batch
+	if (sender->socket < 0)
+	{
+		sender->socket = socket_connect(sender->path);
+		if (sender->socket >= 0)
+			sender->connects++;
+	}
+
+	int sent = -1;
+	if (sender->socket >= 0)
+	{
+		sent = announce_callsites(sender);
+		if (sent > 0)
+		{
+			SimdStreamMessage header = { SIMD_STREAM_MAGIC, SIMD_STREAM_MESSAGE_BATCH, sender->batch_count, 0, sender->dropped };
+			memcpy(sender->message, &header, sizeof(header));
+			memcpy(sender->message + sizeof(header), sender->batch, sender->batch_count * sizeof(SimdCaptureRecord));
+			sent = socket_send(sender->socket, sender->message, sizeof(header) + sender->batch_count * sizeof(SimdCaptureRecord));
+		}
+		if (sent < 0)
+			sender_disconnect(sender);
+	}
+
+	if (sent > 0)
+	{
+		sender->sent += sender->batch_count;
+	}
+	else
+	{
+		sender->dropped += sender->batch_count;
+		sender->batches_dropped++;
+	}
+	sender->batch_count = 0;
+}
+
+function void
+queue_record(SimdStreamSender* sender, const SimdCaptureRing* ring, const SimdCaptureRecord* record)
+{
+	SimdCaptureRecord* queued = &sender->batch[sender->batch_count++];
+	*queued = *record;
+	queued->callsite = simd_capture_remap(&sender->remaps, ring, record->callsite, sender_callsite, sender);
+	if (sender->batch_count == SIMD_STREAM_BATCH_RECORDS)
+		simd_stream_flush(sender);
+}
+
+void
+simd_stream_send_ring(SimdStreamSender* sender, SimdCaptureRing* ring)
+{
+	uint64_t count = simd_capture_count(ring);
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		queue_record(sender, ring, simd_capture_at(ring, i));
+	}
+	simd_capture_reset(ring);
+}
+
+function void
+queue_collected(void* user, const SimdCaptureRing* ring, const SimdCaptureRecord* record)
+{
+	queue_record(user, ring, record);
+}
+
+void
+simd_stream_send_collector(SimdStreamSender* sender, SimdCaptureCollector* collector)
+{
+	simd_capture_collect(collector, queue_collected, sender);
+}
+
+// ----------------------------------------------------------------------------------------------
+// Receiver
+
+bool
+simd_stream_listen(SimdStreamReceiver* receiver, const char* path)
+{
+	memset(receiver, 0, sizeof(*receiver));
+	receiver->listener = -1;
+	receiver->connection = -1;
+#if defined(_WIN32)
+	(void)path;
+	return false;
+#else
+	struct sockaddr_un address;
+	if (!socket_address(path, &address))
+		return false;
+
+	// A viewer that crashed leaves its socket file behind
+	unlink(path);
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return false;
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 1) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	receiver->listener = fd;
+	strncpy(receiver->path, path, sizeof(receiver->path) - 1);
+	receiver->message = malloc(SIMD_STREAM_MESSAGE_MAX_SIZE);
+	receiver->names = array_new(char*);
+	receiver->callsites = array_new(uint32_t);
+	return true;
+#endif
+}
+
+void
+simd_stream_receiver_close(SimdStreamReceiver* receiver)
+{
+#if !defined(_WIN32)
+	if (receiver->connection >= 0)
+		close(receiver->connection);
+	if (receiver->listener >= 0)
+	{
+		close(receiver->listener);
+		unlink(receiver->path);
+	}
+#endif
+	if (receiver->names)
+	{
+		for (uint32_t i = 0; i < array_length(receiver->names); ++i)
+			free(receiver->names[i]);
+		array_free(receiver->names);
+		array_free(receiver->callsites);
+	}
+	free(receiver->message);
+	memset(receiver, 0, sizeof(*receiver));
+	receiver->listener = -1;
+	receiver->connection = -1;
+}
+
+// Names are kept for as long as the receiver, rings keep pointing at them across senders
+function const char*
+receiver_name(SimdStreamReceiver* receiver, const char* name, uint32_t length)
+{
+	for (uint32_t i = 0; i < array_length(receiver->names); ++i)
+	{
+		if (strlen(receiver->names[i]) == length && memcmp(receiver->names[i], name, length) == 0)
+			return receiver->names[i];
+	}
+	char* copy = malloc(length + 1);
+	memcpy(copy, name, length);
+	copy[length] = 0;
+	array_push(receiver->names, copy);
+	return copy;
+}
+
+function uint64_t
+receive_message(SimdStreamReceiver* receiver, SimdCaptureRing* ring, size_t size)
+{
+	SimdStreamMessage header;
+	if (size < sizeof(header))
+		return 0;
+	memcpy(&header, receiver->message, sizeof(header));
+	if (header.magic != SIMD_STREAM_MAGIC)
+		return 0;
+	receiver->sender_dropped = header.dropped;
+
+	if (header.kind == SIMD_STREAM_MESSAGE_CALLSITE)
+	{
+		if (header.count > size - sizeof(header) || header.callsite >= SIMD_CAPTURE_MAX_CALLSITES)
+			return 0;
+		const char* name = (const char*)receiver->message + sizeof(header);
+		uint32_t callsite = UINT32_MAX;
+		if (ring->callsite_count < SIMD_CAPTURE_MAX_CALLSITES)
+		{
+			callsite = simd_capture_callsite(ring, receiver_name(receiver, name, header.count));
+		}
+		else
+		{
+			// A full table asserts on new names, records of those are dropped instead
+			for (uint32_t i = 0; i < ring->callsite_count && callsite == UINT32_MAX; ++i)
+			{
+				if (strlen(ring->callsites[i]) == header.count && memcmp(ring->callsites[i], name, header.count) == 0)
+					callsite = i;
+			}
+		}
+		while (array_length(receiver->callsites) <= header.callsite)
+			array_push(receiver->callsites, UINT32_MAX);
+		receiver->callsites[header.callsite] = callsite;
+		return 0;
+	}
+
+	if (header.kind != SIMD_STREAM_MESSAGE_BATCH || header.count > (size - sizeof(header)) / sizeof(SimdCaptureRecord))
+		return 0;
+	for (uint32_t i = 0; i < header.count; ++i)
+	{
+		SimdCaptureRecord record;
+		memcpy(&record, receiver->message + sizeof(header) + i * sizeof(record), sizeof(record));
+		if (record.callsite >= array_length(receiver->callsites) || receiver->callsites[record.callsite] == UINT32_MAX ||
+			!simd_capture_record_valid(&record))
+			continue;
+		record.callsite = receiver->callsites[record.callsite];
+		simd_capture_append(ring, &record);
+	}
+	receiver->received += header.count;
+	return header.count;
+}
+
+uint64_t
+simd_stream_receive(SimdStreamReceiver* receiver, SimdCaptureRing* ring)
+{
+	uint64_t received = 0;
+#if !defined(_WIN32)
+	if (receiver->listener < 0)
+		return 0;
+
+	int fd = accept(receiver->listener, 0, 0);
+	if (fd >= 0)
+	{
+		// Stream ids belong to the connection
+		if (receiver->connection >= 0)
+			close(receiver->connection);
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		receiver->connection = fd;
+		receiver->connections++;
+		array_clear(receiver->callsites);
+	}
+
+	while (receiver->connection >= 0)
+	{
+		ssize_t size = recv(receiver->connection, receiver->message, SIMD_STREAM_MESSAGE_MAX_SIZE, MSG_DONTWAIT);
+		if (size > 0)
+		{
+			received += receive_message(receiver, ring, (size_t)size);
+			continue;
+		}
+		if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		// The sender went away
+		close(receiver->connection);
+		receiver->connection = -1;
+	}
+#else
+	(void)receiver;
+	(void)ring;
+#endif
+	return received;
+}
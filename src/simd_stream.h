@@ -0,0 +1,83 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "simd_capture.h"
+
+// Streams capture records from the instrumented process to a viewer running as its own process,
+// over a local socket. The sender never blocks: records go out in batches, and a batch that
+// doesn't fit in the socket (or has no viewer to go to) is dropped and counted.
+//
+// Messages, one per datagram so a batch arrives whole or not at all:
+//   SimdStreamMessage header, then
+//   CALLSITE  the name, count bytes without NUL, for the stream id in callsite
+//   BATCH     count SimdCaptureRecords, callsites are stream ids
+// Unix only (SOCK_SEQPACKET), on Windows connecting and listening fail.
+
+#define SIMD_STREAM_MAGIC 0x54535653u  // "SVST"
+#define SIMD_STREAM_BATCH_RECORDS 64
+#define SIMD_STREAM_MESSAGE_MAX_SIZE (sizeof(SimdStreamMessage) + SIMD_STREAM_BATCH_RECORDS * sizeof(SimdCaptureRecord))
+
+typedef enum {
+	SIMD_STREAM_MESSAGE_CALLSITE,
+	SIMD_STREAM_MESSAGE_BATCH,
+} SimdStreamMessageKind;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t kind;      // SimdStreamMessageKind
+	uint32_t count;
+	uint32_t callsite;
+	uint64_t dropped;   // records the sender dropped so far
+} SimdStreamMessage;
+
+typedef struct {
+	int  socket;  // -1 while there is no viewer
+	char path[108];
+
+	SimdCaptureRecord batch[SIMD_STREAM_BATCH_RECORDS];
+	uint32_t          batch_count;
+	uint8_t*          message;
+
+	const char** callsites;  // light_array, ring callsites are remapped to these ids
+	uint8_t*     announced;  // light_array, names the current viewer has been sent
+
+	SimdCaptureRemap* remaps;  // light_array, ids of the rings sent so far
+
+	uint64_t sent;
+	uint64_t dropped;
+	uint64_t batches_dropped;
+	uint64_t connects;
+} SimdStreamSender;
+
+// Never fails, without a viewer listening the records are dropped until one shows up
+void simd_stream_sender_init(SimdStreamSender* sender, const char* path);
+void simd_stream_sender_free(SimdStreamSender* sender);
+
+// Queues the records left in the ring, oldest first, and empties it. Full batches are sent on the way.
+void simd_stream_send_ring(SimdStreamSender* sender, SimdCaptureRing* ring);
+// Queues what every thread captured so far, merged by timestamp
+void simd_stream_send_collector(SimdStreamSender* sender, SimdCaptureCollector* collector);
+// Sends the partial batch
+void simd_stream_flush(SimdStreamSender* sender);
+
+typedef struct {
+	int  listener;
+	int  connection;  // -1 until a sender connects, a new sender replaces the old one
+	char path[108];
+
+	uint8_t* message;
+
+	char**    names;      // light_array, every callsite name received, owned
+	uint32_t* callsites;  // light_array, stream id of the connection to ring callsite
+
+	uint64_t received;
+	uint64_t sender_dropped;  // as last reported by the sender
+	uint64_t connections;
+} SimdStreamReceiver;
+
+bool simd_stream_listen(SimdStreamReceiver* receiver, const char* path);
+void simd_stream_receiver_close(SimdStreamReceiver* receiver);
+
+// Appends whatever arrived since the last call to the ring without waiting. Returns the records received.
+// The ring's callsite names belong to the receiver, free the ring before closing the receiver.
+uint64_t simd_stream_receive(SimdStreamReceiver* receiver, SimdCaptureRing* ring);
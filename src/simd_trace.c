@@ -0,0 +1,775 @@
+#include "simd_trace.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <light_array.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define function static
+
+// ----------------------------------------------------------------------------------------------
+// Delta coding
+
+// Worst case of one coded record, the register bytes plus every varint at full length
+#define DELTA_RECORD_MAX_SIZE 256
+
+function uint8_t*
+put_varint(uint8_t* at, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		*at++ = (uint8_t)value | 0x80;
+		value >>= 7;
+	}
+	*at++ = (uint8_t)value;
+	return at;
+}
+
+function const uint8_t*
+get_varint(const uint8_t* at, const uint8_t* end, uint64_t* value)
+{
+	*value = 0;
+	for (uint32_t shift = 0; at < end && shift < 64; shift += 7)
+	{
+		uint8_t byte = *at++;
+		*value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return at;
+	}
+	return 0;
+}
+
+// Zero runs only end a literal run once they are two bytes long, a lone zero is cheaper inline
+function uint8_t*
+put_rle(uint8_t* at, const uint8_t* bytes, uint32_t size)
+{
+	uint32_t i = 0;
+	while (i < size)
+	{
+		uint32_t zeros = 0;
+		while (i + zeros < size && bytes[i + zeros] == 0)
+			zeros++;
+		i += zeros;
+
+		uint32_t literals = 0;
+		while (i + literals < size && !(bytes[i + literals] == 0 && (i + literals + 1 == size || bytes[i + literals + 1] == 0)))
+			literals++;
+
+		at = put_varint(at, zeros);
+		at = put_varint(at, literals);
+		memcpy(at, bytes + i, literals);
+		at += literals;
+		i += literals;
+	}
+	return at;
+}
+
+function const uint8_t*
+get_rle(const uint8_t* at, const uint8_t* end, uint8_t* bytes, uint32_t size)
+{
+	uint32_t i = 0;
+	while (at && i < size)
+	{
+		uint64_t zeros, literals;
+		at = get_varint(at, end, &zeros);
+		at = at ? get_varint(at, end, &literals) : 0;
+		if (!at || zeros + literals > size - i || literals > (uint64_t)(end - at))
+			return 0;
+		memset(bytes + i, 0, (size_t)zeros);
+		memcpy(bytes + i + zeros, at, (size_t)literals);
+		at += literals;
+		i += (uint32_t)(zeros + literals);
+	}
+	return at;
+}
+
+function __m512i
+load_register(const SimdCaptureRecord* record)
+{
+	uint32_t size = record->register_size_bytes;
+	return _mm512_maskz_loadu_epi8((size >= 64) ? ~0ull : (1ull << size) - 1, record->bytes);
+}
+
+// Lanes that differ, bytes past the register are zero in both so they never count
+function uint64_t
+changed_lanes(__m512i current, __m512i previous, uint32_t width)
+{
+	switch (width)
+	{
+		case 1:  return _mm512_cmpneq_epi8_mask(current, previous);
+		case 2:  return _mm512_cmpneq_epi16_mask(current, previous);
+		case 4:  return _mm512_cmpneq_epi32_mask(current, previous);
+		default: return _mm512_cmpneq_epi64_mask(current, previous);
+	}
+}
+
+function __m512i
+compress_lanes(uint64_t lanes, __m512i value, uint32_t width)
+{
+	switch (width)
+	{
+		case 1:  return _mm512_maskz_compress_epi8(lanes, value);
+		case 2:  return _mm512_maskz_compress_epi16((__mmask32)lanes, value);
+		case 4:  return _mm512_maskz_compress_epi32((__mmask16)lanes, value);
+		default: return _mm512_maskz_compress_epi64((__mmask8)lanes, value);
+	}
+}
+
+function __m512i
+expand_lanes(uint64_t lanes, __m512i value, uint32_t width)
+{
+	switch (width)
+	{
+		case 1:  return _mm512_maskz_expand_epi8(lanes, value);
+		case 2:  return _mm512_maskz_expand_epi16((__mmask32)lanes, value);
+		case 4:  return _mm512_maskz_expand_epi32((__mmask16)lanes, value);
+		default: return _mm512_maskz_expand_epi64((__mmask8)lanes, value);
+	}
+}
+
+function void
+delta_init(SimdTraceDelta* delta, uint32_t callsite_count)
+{
+	delta->previous = array_new(SimdCaptureRecord);
+	delta->valid = array_new(uint8_t);
+	for (uint32_t i = 0; i < callsite_count; ++i)
+	{
+		array_push(delta->previous, ((SimdCaptureRecord) { 0 }));
+		array_push(delta->valid, 0);
+	}
+	delta->timestamp = 0;
+}
+
+function void
+delta_free(SimdTraceDelta* delta)
+{
+	array_free(delta->previous);
+	array_free(delta->valid);
+	memset(delta, 0, sizeof(*delta));
+}
+
+// Keyframe, what follows is coded from scratch
+function void
+delta_reset(SimdTraceDelta* delta)
+{
+	memset(delta->valid, 0, array_length(delta->valid));
+	delta->timestamp = 0;
+}
+
+function size_t
+delta_encode(SimdTraceDelta* delta, const SimdCaptureRecord* record, uint8_t* out)
+{
+	while (array_length(delta->valid) <= record->callsite)
+	{
+		array_push(delta->previous, ((SimdCaptureRecord) { 0 }));
+		array_push(delta->valid, 0);
+	}
+	SimdCaptureRecord* previous = &delta->previous[record->callsite];
+	bool is_delta = record->kind == SIMD_CAPTURE_REGISTER && delta->valid[record->callsite] &&
+		previous->type == record->type && previous->register_size_bytes == record->register_size_bytes;
+
+	uint8_t* at = out + 1;
+	uint8_t tag = 0;
+	at = put_varint(at, record->callsite);
+	int64_t difference = (int64_t)(record->timestamp - delta->timestamp);
+	at = put_varint(at, ((uint64_t)difference << 1) ^ (uint64_t)(difference >> 63));
+	delta->timestamp = record->timestamp;
+	if (is_delta)
+	{
+		tag |= SIMD_TRACE_TAG_DELTA;
+	}
+	else
+	{
+		*at++ = record->type;
+		at = put_varint(at, record->register_size_bytes);
+	}
+	if (record->thread)
+	{
+		tag |= SIMD_TRACE_TAG_THREAD;
+		at = put_varint(at, record->thread);
+	}
+	if (record->masked)
+	{
+		tag |= SIMD_TRACE_TAG_MASKED;
+		at = put_varint(at, record->lane_mask);
+	}
+	if (record->kind == SIMD_CAPTURE_OPERATION)
+		tag |= SIMD_TRACE_TAG_OPERATION;
+	out[0] = tag;
+
+	__m512i current = load_register(record);
+	if (is_delta)
+	{
+		// Only the lanes that changed are stored, XORed so unchanged high bytes are zero runs
+		uint32_t width = simd_capture_lane_size((RegisterType)record->type);
+		__m512i before = _mm512_loadu_si512(previous->bytes);
+		uint64_t lanes = changed_lanes(current, before, width);
+		uint8_t packed[64];
+		_mm512_storeu_si512(packed, compress_lanes(lanes, _mm512_xor_si512(current, before), width));
+		at = put_varint(at, lanes);
+		at = put_rle(at, packed, (uint32_t)_mm_popcnt_u64(lanes) * width);
+	}
+	else
+	{
+		at = put_rle(at, record->bytes, record->register_size_bytes);
+	}
+
+	if (record->kind == SIMD_CAPTURE_REGISTER)
+	{
+		*previous = *record;
+		_mm512_storeu_si512(previous->bytes, current);
+		delta->valid[record->callsite] = 1;
+	}
+	return (size_t)(at - out);
+}
+
+// Null when the stream is cut short or doesn't decode
+function const uint8_t*
+delta_decode(SimdTraceDelta* delta, const uint8_t* at, const uint8_t* end, SimdCaptureRecord* record)
+{
+	if (at >= end)
+		return 0;
+	memset(record, 0, sizeof(*record));
+	uint8_t tag = *at++;
+
+	uint64_t callsite, difference;
+	at = get_varint(at, end, &callsite);
+	at = at ? get_varint(at, end, &difference) : 0;
+	if (!at || callsite >= array_length(delta->valid))
+		return 0;
+	SimdCaptureRecord* previous = &delta->previous[callsite];
+	if ((tag & SIMD_TRACE_TAG_DELTA) && !delta->valid[callsite])
+		return 0;
+
+	delta->timestamp += (uint64_t)((int64_t)(difference >> 1) ^ -(int64_t)(difference & 1));
+	record->timestamp = delta->timestamp;
+	record->callsite = (uint32_t)callsite;
+	record->kind = (tag & SIMD_TRACE_TAG_OPERATION) ? SIMD_CAPTURE_OPERATION : SIMD_CAPTURE_REGISTER;
+	record->lane_mask = ~0ull;
+	if (tag & SIMD_TRACE_TAG_DELTA)
+	{
+		record->type = previous->type;
+		record->register_size_bytes = previous->register_size_bytes;
+	}
+	else
+	{
+		uint64_t size;
+		if (at >= end)
+			return 0;
+		record->type = *at++;
+		at = get_varint(at, end, &size);
+		if (!at || size > sizeof(record->bytes))
+			return 0;
+		record->register_size_bytes = (uint16_t)size;
+	}
+
+	uint64_t value;
+	if (at && (tag & SIMD_TRACE_TAG_THREAD))
+	{
+		at = get_varint(at, end, &value);
+		record->thread = (uint16_t)value;
+	}
+	if (at && (tag & SIMD_TRACE_TAG_MASKED))
+	{
+		at = get_varint(at, end, &value);
+		record->lane_mask = value;
+		record->masked = 1;
+	}
+	if (!at)
+		return 0;
+
+	if (tag & SIMD_TRACE_TAG_DELTA)
+	{
+		uint32_t width = simd_capture_lane_size((RegisterType)record->type);
+		uint64_t lanes;
+		uint8_t packed[64] = { 0 };
+		at = get_varint(at, end, &lanes);
+		if (!at || (uint32_t)_mm_popcnt_u64(lanes) * width > record->register_size_bytes)
+			return 0;
+		at = get_rle(at, end, packed, (uint32_t)_mm_popcnt_u64(lanes) * width);
+		if (!at)
+			return 0;
+		__m512i changes = expand_lanes(lanes, _mm512_loadu_si512(packed), width);
+		_mm512_storeu_si512(record->bytes, _mm512_xor_si512(_mm512_loadu_si512(previous->bytes), changes));
+	}
+	else
+	{
+		at = get_rle(at, end, record->bytes, record->register_size_bytes);
+		if (!at)
+			return 0;
+	}
+
+	if (record->kind == SIMD_CAPTURE_REGISTER)
+	{
+		*previous = *record;
+		delta->valid[callsite] = 1;
+	}
+	return at;
+}
+
+// ----------------------------------------------------------------------------------------------
+// Writer
+
+function void
+writer_flush(SimdTraceWriter* writer)
+{
+	if (fwrite(writer->buffer, 1, writer->buffer_used, writer->file) != writer->buffer_used)
+		writer->failed = true;
+	writer->buffer_used = 0;
+}
+
+function void
+writer_append(SimdTraceWriter* writer, const void* data, size_t size)
+{
+	if (writer->buffer_used + size > SIMD_TRACE_WRITE_BUFFER_SIZE)
+		writer_flush(writer);
+	// The index of a long trace is appended in one go and can be bigger than the whole buffer
+	if (size > SIMD_TRACE_WRITE_BUFFER_SIZE)
+	{
+		if (fwrite(data, 1, size, writer->file) != size)
+			writer->failed = true;
+		return;
+	}
+	memcpy(writer->buffer + writer->buffer_used, data, size);
+	writer->buffer_used += size;
+}
+
+function uint32_t
+writer_callsite(void* user, const char* name)
+{
+	SimdTraceWriter* writer = user;
+	for (uint32_t i = 0; i < array_length(writer->callsites); ++i)
+	{
+		if (strcmp(writer->callsites[i], name) == 0)
+			return i;
+	}
+	array_push(writer->callsites, name);
+	return (uint32_t)array_length(writer->callsites) - 1;
+}
+
+function void
+writer_record(SimdTraceWriter* writer, const SimdCaptureRecord* record)
+{
+	if (writer->record_count % writer->index_interval == 0)
+	{
+		array_push(writer->index, ((SimdTraceIndexEntry) { record->timestamp, writer->record_count, writer->record_bytes }));
+		if (writer->flags & SIMD_TRACE_DELTA)
+			delta_reset(&writer->delta);
+	}
+
+	if (writer->flags & SIMD_TRACE_DELTA)
+	{
+		uint8_t coded[DELTA_RECORD_MAX_SIZE];
+		size_t size = delta_encode(&writer->delta, record, coded);
+		writer_append(writer, coded, size);
+		writer->record_bytes += size;
+	}
+	else
+	{
+		writer_append(writer, record, sizeof(*record));
+		writer->record_bytes += sizeof(*record);
+	}
+	writer->record_count++;
+}
+
+bool
+simd_trace_writer_open(SimdTraceWriter* writer, const char* filename, uint32_t index_interval, uint32_t flags)
+{
+	memset(writer, 0, sizeof(*writer));
+	writer->file = fopen(filename, "wb");
+	if (!writer->file)
+		return false;
+
+	writer->buffer = malloc(SIMD_TRACE_WRITE_BUFFER_SIZE);
+	writer->index_interval = (index_interval > 0) ? index_interval : SIMD_TRACE_DEFAULT_INDEX_INTERVAL;
+	writer->flags = flags;
+	writer->index = array_new(SimdTraceIndexEntry);
+	delta_init(&writer->delta, 0);
+	writer->callsites = array_new(const char*);
+	writer->remaps = array_new(SimdCaptureRemap);
+
+	SimdTraceHeader header = { 0 };
+	memcpy(header.magic, SIMD_TRACE_MAGIC, sizeof(header.magic));
+	header.version = SIMD_TRACE_VERSION;
+	header.record_size = sizeof(SimdCaptureRecord);
+	header.index_interval = writer->index_interval;
+	header.record_offset = sizeof(SimdTraceHeader);
+	writer_append(writer, &header, sizeof(header));
+	return true;
+}
+
+void
+simd_trace_write_ring(SimdTraceWriter* writer, SimdCaptureRing* ring)
+{
+	// Ring callsite ids are local to the ring
+	uint32_t remap[SIMD_CAPTURE_MAX_CALLSITES];
+	for (uint32_t i = 0; i < ring->callsite_count; ++i)
+		remap[i] = writer_callsite(writer, ring->callsites[i]);
+
+	uint64_t count = simd_capture_count(ring);
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		SimdCaptureRecord record = *simd_capture_at(ring, i);
+		if (record.callsite < ring->callsite_count)
+			record.callsite = remap[record.callsite];
+		writer_record(writer, &record);
+	}
+	simd_capture_reset(ring);
+}
+
+function void
+write_collected(void* user, const SimdCaptureRing* ring, const SimdCaptureRecord* collected)
+{
+	SimdTraceWriter* writer = user;
+	SimdCaptureRecord record = *collected;
+	record.callsite = simd_capture_remap(&writer->remaps, ring, collected->callsite, writer_callsite, writer);
+	writer_record(writer, &record);
+}
+
+uint64_t
+simd_trace_write_collector(SimdTraceWriter* writer, SimdCaptureCollector* collector)
+{
+	return simd_capture_collect(collector, write_collected, writer);
+}
+
+bool
+simd_trace_writer_close(SimdTraceWriter* writer)
+{
+	SimdTraceHeader header = { 0 };
+	memcpy(header.magic, SIMD_TRACE_MAGIC, sizeof(header.magic));
+	header.version = SIMD_TRACE_VERSION;
+	header.record_size = sizeof(SimdCaptureRecord);
+	header.index_interval = writer->index_interval;
+	header.flags = writer->flags;
+	header.callsite_count = (uint32_t)array_length(writer->callsites);
+	header.record_offset = sizeof(SimdTraceHeader);
+	header.record_count = writer->record_count;
+	header.strings_offset = header.record_offset + writer->record_bytes;
+
+	uint64_t strings_size = 0;
+	for (uint32_t i = 0; i < header.callsite_count; ++i)
+	{
+		uint32_t length = (uint32_t)strlen(writer->callsites[i]);
+		writer_append(writer, &length, sizeof(length));
+		writer_append(writer, writer->callsites[i], length + 1);
+		strings_size += sizeof(length) + length + 1;
+	}
+
+	// Index entries are 8 byte aligned
+	static const uint8_t padding[8] = { 0 };
+	uint64_t pad = (8 - (header.strings_offset + strings_size) % 8) % 8;
+	writer_append(writer, padding, (size_t)pad);
+	header.index_offset = header.strings_offset + strings_size + pad;
+	header.index_count = array_length(writer->index);
+	writer_append(writer, writer->index, (size_t)(header.index_count * sizeof(SimdTraceIndexEntry)));
+	writer_flush(writer);
+
+	// The header is written last, an interrupted trace keeps a zero record count
+	bool ok = !writer->failed && fseek(writer->file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, writer->file) == 1;
+	ok = (fclose(writer->file) == 0) && ok;
+
+	free(writer->buffer);
+	array_free(writer->index);
+	array_free(writer->callsites);
+	simd_capture_remap_free(writer->remaps);
+	delta_free(&writer->delta);
+	memset(writer, 0, sizeof(*writer));
+	return ok;
+}
+
+// ----------------------------------------------------------------------------------------------
+// Reader
+
+function bool
+map_file(SimdTrace* trace, const char* filename)
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	void* base = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+	if (!base)
+	{
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	trace->file_handle = file;
+	trace->mapping_handle = mapping;
+	trace->base = base;
+	trace->size = (uint64_t)size.QuadPart;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+	void* base = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return false;
+	trace->base = base;
+	trace->size = (uint64_t)st.st_size;
+#endif
+	return true;
+}
+
+function void
+unmap_file(SimdTrace* trace)
+{
+#if defined(_WIN32)
+	UnmapViewOfFile(trace->base);
+	CloseHandle(trace->mapping_handle);
+	CloseHandle(trace->file_handle);
+#else
+	munmap((void*)trace->base, (size_t)trace->size);
+#endif
+}
+
+// Everything the header of a closed trace points at has to lie within the file, and so does
+// every range the string table and the index describe. The cursors trust them after this.
+function bool
+closed_trace_fits(const SimdTrace* trace)
+{
+	const SimdTraceHeader* header = trace->header;
+	if (header->strings_offset < header->record_offset || header->strings_offset > trace->size ||
+		header->index_offset < header->strings_offset || header->index_offset > trace->size ||
+		header->index_count > (trace->size - header->index_offset) / sizeof(SimdTraceIndexEntry))
+		return false;
+
+	uint64_t record_bytes = header->strings_offset - header->record_offset;
+	if (!(header->flags & SIMD_TRACE_DELTA) && header->record_count > record_bytes / header->record_size)
+		return false;
+
+	const SimdTraceIndexEntry* index = (const SimdTraceIndexEntry*)(trace->base + header->index_offset);
+	for (uint64_t i = 0; i < header->index_count; ++i)
+	{
+		if (index[i].record >= header->record_count || index[i].offset > record_bytes)
+			return false;
+	}
+
+	const uint8_t* at = trace->base + header->strings_offset;
+	const uint8_t* end = trace->base + header->index_offset;
+	for (uint32_t i = 0; i < header->callsite_count; ++i)
+	{
+		uint32_t length;
+		if ((uint64_t)(end - at) < sizeof(length))
+			return false;
+		memcpy(&length, at, sizeof(length));
+		if ((uint64_t)length + 1 > (uint64_t)(end - at) - sizeof(length) || at[sizeof(length) + length] != 0)
+			return false;
+		at += sizeof(length) + length + 1;
+	}
+	return true;
+}
+
+bool
+simd_trace_open(SimdTrace* trace, const char* filename)
+{
+	memset(trace, 0, sizeof(*trace));
+	if (!map_file(trace, filename))
+		return false;
+
+	const SimdTraceHeader* header = (const SimdTraceHeader*)trace->base;
+	if (trace->size < sizeof(SimdTraceHeader) || memcmp(header->magic, SIMD_TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != SIMD_TRACE_VERSION || header->record_size != sizeof(SimdCaptureRecord) ||
+		header->index_interval == 0 || header->record_offset < sizeof(SimdTraceHeader) || header->record_offset > trace->size)
+	{
+		unmap_file(trace);
+		memset(trace, 0, sizeof(*trace));
+		return false;
+	}
+
+	// Only closing patches the offsets in, a closed trace may still hold no records
+	bool closed = header->index_offset != 0;
+	trace->header = header;
+	if (closed && !closed_trace_fits(trace))
+	{
+		unmap_file(trace);
+		memset(trace, 0, sizeof(*trace));
+		return false;
+	}
+	if (!(header->flags & SIMD_TRACE_DELTA))
+		trace->records = (const SimdCaptureRecord*)(trace->base + header->record_offset);
+	trace->callsites = array_new(const char*);
+	if (closed)
+	{
+		trace->record_count = header->record_count;
+		trace->index = (const SimdTraceIndexEntry*)(trace->base + header->index_offset);
+		trace->index_count = header->index_count;
+
+		const uint8_t* at = trace->base + header->strings_offset;
+		for (uint32_t i = 0; i < header->callsite_count; ++i)
+		{
+			uint32_t length;
+			memcpy(&length, at, sizeof(length));
+			array_push(trace->callsites, (const char*)(at + sizeof(length)));
+			at += sizeof(length) + length + 1;
+		}
+	}
+	else if (trace->records)
+	{
+		// Never closed, whatever whole records made it to disk are still usable
+		trace->record_count = (trace->size - header->record_offset) / header->record_size;
+	}
+	return true;
+}
+
+void
+simd_trace_close(SimdTrace* trace)
+{
+	if (!trace->base)
+		return;
+	unmap_file(trace);
+	array_free(trace->callsites);
+	memset(trace, 0, sizeof(*trace));
+}
+
+const char*
+simd_trace_callsite_name(const SimdTrace* trace, uint32_t callsite)
+{
+	return (callsite < array_length(trace->callsites)) ? trace->callsites[callsite] : "";
+}
+
+uint64_t
+simd_trace_find_timestamp(const SimdTrace* trace, uint64_t timestamp)
+{
+	// Last index entry before the timestamp, then a scan of at most one interval
+	uint64_t first = 0;
+	uint64_t low = 0;
+	uint64_t high = trace->index_count;
+	while (low < high)
+	{
+		uint64_t mid = low + (high - low) / 2;
+		if (trace->index[mid].timestamp < timestamp)
+		{
+			first = trace->index[mid].record;
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	SimdTraceCursor cursor;
+	SimdCaptureRecord record;
+	simd_trace_cursor_init(trace, &cursor);
+	simd_trace_seek(trace, &cursor, first);
+	uint64_t found = trace->record_count;
+	while (simd_trace_next(trace, &cursor, &record))
+	{
+		if (record.timestamp >= timestamp)
+		{
+			found = cursor.record - 1;
+			break;
+		}
+	}
+	simd_trace_cursor_free(&cursor);
+	return found;
+}
+
+void
+simd_trace_cursor_init(const SimdTrace* trace, SimdTraceCursor* cursor)
+{
+	memset(cursor, 0, sizeof(*cursor));
+	if (!trace->records)
+		delta_init(&cursor->delta, trace->header->callsite_count);
+	simd_trace_seek(trace, cursor, 0);
+}
+
+void
+simd_trace_cursor_free(SimdTraceCursor* cursor)
+{
+	if (cursor->delta.previous)
+		delta_free(&cursor->delta);
+	memset(cursor, 0, sizeof(*cursor));
+}
+
+void
+simd_trace_seek(const SimdTrace* trace, SimdTraceCursor* cursor, uint64_t record)
+{
+	cursor->record = (record < trace->record_count) ? record : trace->record_count;
+	if (trace->records)
+		return;
+
+	// Last keyframe at or before the record, then decode up to it
+	uint64_t keyframe = 0;
+	uint64_t offset = 0;
+	for (uint64_t low = 0, high = trace->index_count; low < high;)
+	{
+		uint64_t mid = low + (high - low) / 2;
+		if (trace->index[mid].record <= cursor->record)
+		{
+			keyframe = trace->index[mid].record;
+			offset = trace->index[mid].offset;
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	uint64_t target = cursor->record;
+	cursor->record = keyframe;
+	cursor->at = trace->base + trace->header->record_offset + offset;
+
+	SimdCaptureRecord skipped;
+	while (cursor->record < target && simd_trace_next(trace, cursor, &skipped))
+		;
+}
+
+bool
+simd_trace_next(const SimdTrace* trace, SimdTraceCursor* cursor, SimdCaptureRecord* record)
+{
+	if (cursor->record >= trace->record_count)
+		return false;
+	if (trace->records)
+	{
+		*record = trace->records[cursor->record];
+		if (!simd_capture_record_valid(record))
+		{
+			cursor->record = trace->record_count;
+			return false;
+		}
+		cursor->record++;
+		return true;
+	}
+
+	// The writer started over at every keyframe
+	if (cursor->record % trace->header->index_interval == 0)
+		delta_reset(&cursor->delta);
+
+	const uint8_t* end = trace->base + trace->header->strings_offset;
+	const uint8_t* at = delta_decode(&cursor->delta, cursor->at, end, record);
+	if (!at || !simd_capture_record_valid(record))
+	{
+		// Corrupt stream, nothing after it can be trusted
+		cursor->record = trace->record_count;
+		return false;
+	}
+	cursor->at = at;
+	cursor->record++;
+	return true;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "simd_capture.h"
+
+// Trace file layout, all little endian:
+//   header        SimdTraceHeader, offsets are patched in when the writer closes
+//   records       SimdCaptureRecord each, record i is at record_offset + i * record_size
+//                 or with SIMD_TRACE_DELTA a byte stream of delta coded records
+//   string table  u32 length + name + NUL per callsite, in callsite id order
+//   index         SimdTraceIndexEntry for every index_interval-th record
+// A plain trace that was never closed, index_offset still 0, opens with the record count taken
+// from the file size.
+//
+// Delta coded record:
+//   u8      tag, SIMD_TRACE_TAG_* bits
+//   varint  callsite
+//   varint  zigzag timestamp difference to the previous record
+//   u8      type, varint register size     unless DELTA, then both are the previous record's
+//   varint  thread                         if THREAD
+//   varint  lane mask                      if MASKED
+//   varint  changed lane mask              if DELTA
+//   rle     register bytes, or with DELTA the changed lanes of the XOR with the previous
+//           record of the callsite packed together
+// rle is varint zero count, varint literal count, literals, repeated until the bytes are covered.
+// Index entries are keyframes, the records after them never refer to a record before them.
+
+#define SIMD_TRACE_MAGIC "SIMDTRC1"
+#define SIMD_TRACE_VERSION 2
+
+#define SIMD_TRACE_DELTA 0x1  // header flag
+
+#define SIMD_TRACE_TAG_DELTA     0x1
+#define SIMD_TRACE_TAG_MASKED    0x2
+#define SIMD_TRACE_TAG_OPERATION 0x4
+#define SIMD_TRACE_TAG_THREAD    0x8
+#define SIMD_TRACE_DEFAULT_INDEX_INTERVAL 4096
+#define SIMD_TRACE_WRITE_BUFFER_SIZE (1024 * 1024)
+
+typedef struct {
+	char     magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t index_interval;
+	uint32_t callsite_count;
+	uint64_t record_offset;
+	uint64_t record_count;
+	uint64_t strings_offset;
+	uint64_t index_offset;
+	uint64_t index_count;
+	uint32_t flags;
+	uint8_t  reserved[60];  // keeps the records cache line aligned in the mapping
+} SimdTraceHeader;
+
+typedef struct {
+	uint64_t timestamp;  // of the first record the entry covers
+	uint64_t record;
+	uint64_t offset;     // of the record from record_offset
+} SimdTraceIndexEntry;
+
+// Last record of every callsite since the keyframe, what delta coded records are relative to
+typedef struct {
+	SimdCaptureRecord* previous;  // light_array indexed by callsite
+	uint8_t*           valid;     // light_array
+	uint64_t           timestamp;
+} SimdTraceDelta;
+
+typedef struct {
+	FILE*    file;
+	uint8_t* buffer;
+	size_t   buffer_used;
+	bool     failed;  // a write came up short, close reports it
+
+	uint64_t             record_count;
+	uint64_t             record_bytes;  // written after the header
+	uint32_t             index_interval;
+	uint32_t             flags;
+	SimdTraceIndexEntry* index;      // light_array
+	const char**         callsites;  // light_array, ring callsites are remapped to these ids
+	SimdCaptureRemap*    remaps;     // light_array, ids of the collector's rings
+	SimdTraceDelta       delta;
+} SimdTraceWriter;
+
+// flags is 0 or SIMD_TRACE_DELTA
+bool simd_trace_writer_open(SimdTraceWriter* writer, const char* filename, uint32_t index_interval, uint32_t flags);
+// False if any part of the trace didn't make it to the file
+bool simd_trace_writer_close(SimdTraceWriter* writer);
+
+// Appends the records left in the ring, oldest first, and empties it
+void simd_trace_write_ring(SimdTraceWriter* writer, SimdCaptureRing* ring);
+// Appends what every thread captured so far, merged by timestamp. Returns the records written.
+uint64_t simd_trace_write_collector(SimdTraceWriter* writer, SimdCaptureCollector* collector);
+
+typedef struct {
+	const uint8_t* base;
+	uint64_t       size;
+
+	const SimdTraceHeader*     header;
+	const SimdCaptureRecord*   records;  // null for delta traces, read them with a cursor
+	uint64_t                   record_count;
+	const SimdTraceIndexEntry* index;
+	uint64_t                   index_count;
+	const char**               callsites;  // light_array, pointing into the mapping
+
+#if defined(_WIN32)
+	void* file_handle;
+	void* mapping_handle;
+#endif
+} SimdTrace;
+
+// Maps the file, false for truncated or corrupt traces whose header points outside it.
+// Nothing but the string table and index is read until records are asked for.
+bool simd_trace_open(SimdTrace* trace, const char* filename);
+void simd_trace_close(SimdTrace* trace);
+
+const char* simd_trace_callsite_name(const SimdTrace* trace, uint32_t callsite);
+
+// First record with a timestamp at or after the given one, record_count when there is none
+uint64_t simd_trace_find_timestamp(const SimdTrace* trace, uint64_t timestamp);
+
+// Reads records of either kind of trace in order, decoding delta traces as it goes
+typedef struct {
+	uint64_t       record;  // index of the record next returns
+	const uint8_t* at;
+	SimdTraceDelta delta;
+} SimdTraceCursor;
+
+void simd_trace_cursor_init(const SimdTrace* trace, SimdTraceCursor* cursor);
+void simd_trace_cursor_free(SimdTraceCursor* cursor);
+// Delta traces decode forward from the keyframe before the record
+void simd_trace_seek(const SimdTrace* trace, SimdTraceCursor* cursor, uint64_t record);
+// Also stops for good at the first record that isn't simd_capture_record_valid
+bool simd_trace_next(const SimdTrace* trace, SimdTraceCursor* cursor, SimdCaptureRecord* record);
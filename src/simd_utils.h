@@ -1,3 +1,4 @@
+#pragma once
 #include <immintrin.h>
 #include <stdint.h>
 
@@ -67,4 +68,47 @@ simd_extract_f64_from_128(__m128d reg, int32_t index)
     double temp[sizeof(__m128d) / sizeof(double)];
     _mm_store_pd(temp, reg);
     return temp[index];
-}
\ No newline at end of file
+}
+// Whole register decoded once, lanes are then read through the typed views
+
+typedef union {
+    uint8_t  u8[sizeof(__m512i)];
+    int8_t   s8[sizeof(__m512i)];
+    uint16_t u16[sizeof(__m512i) / sizeof(uint16_t)];
+    int16_t  s16[sizeof(__m512i) / sizeof(int16_t)];
+    uint32_t u32[sizeof(__m512i) / sizeof(uint32_t)];
+    int32_t  s32[sizeof(__m512i) / sizeof(int32_t)];
+    uint64_t u64[sizeof(__m512i) / sizeof(uint64_t)];
+    int64_t  s64[sizeof(__m512i) / sizeof(int64_t)];
+    float    f32[sizeof(__m512i) / sizeof(float)];
+    double   f64[sizeof(__m512i) / sizeof(double)];
+    __m128i  i128;
+    __m256i  i256;
+    __m512i  i512;
+} SimdLanes;
+
+static inline SimdLanes
+simd_lanes_from_512(__m512i reg)
+{
+    SimdLanes lanes;
+    _mm512_store_si512(&lanes.i512, reg);
+    return lanes;
+}
+
+static inline SimdLanes
+simd_lanes_from_256(__m256i reg)
+{
+    SimdLanes lanes;
+    _mm512_store_si512(&lanes.i512, _mm512_setzero_si512());
+    _mm256_store_si256(&lanes.i256, reg);
+    return lanes;
+}
+
+static inline SimdLanes
+simd_lanes_from_128(__m128i reg)
+{
+    SimdLanes lanes;
+    _mm512_store_si512(&lanes.i512, _mm512_setzero_si512());
+    _mm_store_si128(&lanes.i128, reg);
+    return lanes;
+}
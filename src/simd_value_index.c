@@ -0,0 +1,122 @@
+#include "simd_value_index.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <light_array.h>
+
+#define function static
+
+function uint32_t
+value_hash(uint64_t bits, uint32_t lane_size)
+{
+	uint64_t h = bits ^ ((uint64_t)lane_size << 56);
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	return (uint32_t)h;
+}
+
+uint64_t
+simd_lane_bits(const SimdLanes* lanes, int32_t lane, uint32_t lane_size)
+{
+	switch (lane_size)
+	{
+		case 1: return lanes->u8[lane];
+		case 2: return lanes->u16[lane];
+		case 4: return lanes->u32[lane];
+		case 8: return lanes->u64[lane];
+		default: assert(false);
+	}
+	return 0;
+}
+
+void
+value_index_init(ValueIndex* index)
+{
+	index->entries = array_new(ValueIndexEntry);
+	index->buckets = 0;
+	index->bucket_count = 0;
+}
+
+void
+value_index_free(ValueIndex* index)
+{
+	array_free(index->entries);
+	free(index->buckets);
+	*index = (ValueIndex){ 0 };
+}
+
+void
+value_index_clear(ValueIndex* index)
+{
+	array_clear(index->entries);
+}
+
+void
+value_index_add(ValueIndex* index, int32_t row, const SimdLanes* lanes, uint32_t register_size_bytes, uint32_t lane_size)
+{
+	for (uint32_t i = 0; i < register_size_bytes / lane_size; ++i)
+	{
+		ValueIndexEntry entry = {
+			.bits = simd_lane_bits(lanes, i, lane_size),
+			.row = row,
+			.lane = (uint8_t)i,
+			.lane_size = (uint8_t)lane_size,
+			.next = -1,
+		};
+		array_push(index->entries, entry);
+	}
+}
+
+void
+value_index_build(ValueIndex* index)
+{
+	// Keep the load factor at or below one half
+	uint32_t entry_count = (uint32_t)array_length(index->entries);
+	uint32_t bucket_count = 16;
+	while (bucket_count < entry_count * 2)
+		bucket_count *= 2;
+	if (bucket_count > index->bucket_count)
+	{
+		index->buckets = realloc(index->buckets, bucket_count * sizeof(*index->buckets));
+		index->bucket_count = bucket_count;
+	}
+	memset(index->buckets, 0xff, index->bucket_count * sizeof(*index->buckets));
+
+	// Inserted in reverse so each chain walks its rows from the top
+	for (int32_t i = (int32_t)entry_count - 1; i >= 0; --i)
+	{
+		ValueIndexEntry* entry = &index->entries[i];
+		uint32_t bucket = value_hash(entry->bits, entry->lane_size) & (index->bucket_count - 1);
+		entry->next = index->buckets[bucket];
+		index->buckets[bucket] = i;
+	}
+}
+
+function int32_t
+value_index_match(const ValueIndex* index, int32_t entry, uint64_t bits, uint32_t lane_size)
+{
+	for (; entry >= 0; entry = index->entries[entry].next)
+	{
+		if (index->entries[entry].bits == bits && index->entries[entry].lane_size == lane_size)
+			return entry;
+	}
+	return -1;
+}
+
+int32_t
+value_index_first(const ValueIndex* index, uint64_t bits, uint32_t lane_size)
+{
+	if (index->bucket_count == 0)
+		return -1;
+	uint32_t bucket = value_hash(bits, lane_size) & (index->bucket_count - 1);
+	return value_index_match(index, index->buckets[bucket], bits, lane_size);
+}
+
+int32_t
+value_index_next(const ValueIndex* index, int32_t entry)
+{
+	const ValueIndexEntry* current = &index->entries[entry];
+	return value_index_match(index, current->next, current->bits, current->lane_size);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include "simd_utils.h"
+
+// Every lane of the register rows keyed by its bit pattern and width, so the lanes equal
+// to the hovered one are found without comparing it against every lane of every row.
+// Keying on bits makes type-punned views of the same data match each other.
+typedef struct {
+	uint64_t bits;
+	int32_t  row;
+	uint8_t  lane;
+	uint8_t  lane_size;
+	int32_t  next;  // next entry in the same bucket, -1 ends the chain
+} ValueIndexEntry;
+
+typedef struct {
+	ValueIndexEntry* entries;       // light_array
+	int32_t*         buckets;       // first entry of each bucket, -1 when empty
+	uint32_t         bucket_count;  // power of two
+} ValueIndex;
+
+void value_index_init(ValueIndex* index);
+void value_index_free(ValueIndex* index);
+void value_index_clear(ValueIndex* index);
+
+// Adds the lanes of one row, value_index_build must run before looking anything up
+void value_index_add(ValueIndex* index, int32_t row, const SimdLanes* lanes, uint32_t register_size_bytes, uint32_t lane_size);
+void value_index_build(ValueIndex* index);
+
+// Walks the entries with the given bits and lane size, returns -1 when there are no more
+int32_t value_index_first(const ValueIndex* index, uint64_t bits, uint32_t lane_size);
+int32_t value_index_next(const ValueIndex* index, int32_t entry);
+
+uint64_t simd_lane_bits(const SimdLanes* lanes, int32_t lane, uint32_t lane_size);
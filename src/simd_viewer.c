@@ -1,10 +1,23 @@
+// The viewer itself always has the pushes, only the instrumented code drops them
+#undef SIMD_VIEWER_DISABLE
+#define LIGHT_ARENA_IMPLEMENT
+#define HT_IMPLEMENTATION
 #include "simd_viewer.h"
 #include "simd_utils.h"
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <light_array.h>
+#include <rlgl.h>
+#include "simd_software.h"
+#include "simd_format.h"
 
 #define ARRAY_LENGTH(A) (sizeof(A) / sizeof(*(A)))
 #define function static
 
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
 function Vector2
 vec2(float v)
 {
@@ -38,303 +51,1573 @@ fmt_unsigned64(bool hex)
 	return (hex) ? "0x%llx" : "%llu";
 }
 
-function bool
-regtype_is_signed(RegisterType rtype)
+function int
+regtype_to_bytesize(RegisterType regtype)
+{
+	switch (regtype)
+	{
+	default:
+		case REGISTER_TYPE_S8:  case REGISTER_TYPE_U8: return sizeof(int8_t);
+		case REGISTER_TYPE_S16: case REGISTER_TYPE_U16: return sizeof(int16_t);
+		case REGISTER_TYPE_S32: case REGISTER_TYPE_U32: return sizeof(int32_t);
+		case REGISTER_TYPE_S64: case REGISTER_TYPE_U64: return sizeof(int64_t);
+		case REGISTER_TYPE_F32: return sizeof(float);
+		case REGISTER_TYPE_F64: return sizeof(double);
+	}
+}
+
+function Vector2
+line_position(int index)
+{
+	return (Vector2) { 20.0f, 20.0f + (float)((BYTE_SIZE + Y_SPACING) * index) };
+}
+
+// ----------------------------------------------------------------------------------------------
+// Batching, quads and text are collected over the frame and submitted once per layer
+
+function void
+batch_quad(SimdViewer* sv, SimdViewerLayer layer, Rectangle rect, Color color)
+{
+	array_push(sv->quads[layer], ((BatchQuad) { rect, color }));
+}
+
+function void
+batch_lines(SimdViewer* sv, SimdViewerLayer layer, Rectangle rect, float thickness, Color color)
+{
+	batch_quad(sv, layer, (Rectangle) { rect.x, rect.y, rect.width, thickness }, color);
+	batch_quad(sv, layer, (Rectangle) { rect.x, rect.y + rect.height - thickness, rect.width, thickness }, color);
+	batch_quad(sv, layer, (Rectangle) { rect.x, rect.y + thickness, thickness, rect.height - thickness * 2 }, color);
+	batch_quad(sv, layer, (Rectangle) { rect.x + rect.width - thickness, rect.y + thickness, thickness, rect.height - thickness * 2 }, color);
+}
+
+function void
+batch_text(SimdViewer* sv, Vector2 position, const char* text)
+{
+	// Lane text can be evicted from the cache and TextFormat buffers rotate before the batch is submitted
+	size_t length = strlen(text) + 1;
+	char* copy = memcpy(arena_alloc(sv->frame_arena, length), text, length);
+	array_push(sv->texts, ((BatchText) { position, copy }));
+}
+
+function void
+raylib_quads(SimdViewerBackend* backend, const BatchQuad* quads, size_t count)
+{
+	(void)backend;
+	if (count == 0)
+		return;
+
+	// Same texture and coordinates raylib uses for its shapes, so all quads go in one batch
+	Texture2D texture = GetShapesTexture();
+	Rectangle source = GetShapesTextureRectangle();
+	float u0 = source.x / texture.width;
+	float v0 = source.y / texture.height;
+	float u1 = (source.x + source.width) / texture.width;
+	float v1 = (source.y + source.height) / texture.height;
+
+	rlSetTexture(texture.id);
+	rlBegin(RL_QUADS);
+	rlNormal3f(0.0f, 0.0f, 1.0f);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Rectangle r = quads[i].rect;
+		Color c = quads[i].color;
+		rlColor4ub(c.r, c.g, c.b, c.a);
+		rlTexCoord2f(u0, v0); rlVertex2f(r.x, r.y);
+		rlTexCoord2f(u0, v1); rlVertex2f(r.x, r.y + r.height);
+		rlTexCoord2f(u1, v1); rlVertex2f(r.x + r.width, r.y + r.height);
+		rlTexCoord2f(u1, v0); rlVertex2f(r.x + r.width, r.y);
+	}
+	rlEnd();
+	rlSetTexture(0);
+}
+
+function void
+raylib_text(SimdViewerBackend* backend, Font font, const BatchText* texts, size_t count, Color color)
+{
+	(void)backend;
+	for (size_t i = 0; i < count; ++i)
+		DrawTextEx(font, texts[i].text, texts[i].position, (float)font.baseSize, 0, color);
+}
+
+static SimdViewerBackend raylib_backend = { raylib_quads, raylib_text };
+
+function void
+submit_batch(SimdViewer* sv, SimdViewerBackend* backend)
+{
+	BatchQuad* background = sv->quads[SIMD_VIEWER_LAYER_BACKGROUND];
+	BatchQuad* overlay = sv->quads[SIMD_VIEWER_LAYER_OVERLAY];
+	backend->quads(backend, background, array_length(background));
+	backend->text(backend, sv->font, sv->texts, array_length(sv->texts), FONT_COLOR);
+	backend->quads(backend, overlay, array_length(overlay));
+
+	for (int layer = 0; layer < SIMD_VIEWER_LAYER_COUNT; ++layer)
+		array_clear(sv->quads[layer]);
+	array_clear(sv->texts);
+}
+
+function Rectangle
+box_rect(Vector2 pos, int byte_size)
+{
+	Rectangle rect = {
+		.x = pos.x,
+		.y = pos.y,
+		.width = (float)box_width(byte_size),
+		.height = (float)BYTE_SIZE
+	};
+	return rect;
+}
+
+function Rectangle
+render_box_colored(SimdViewer* sv, Vector2 pos, int byte_size, Color color)
+{
+	Rectangle rect = box_rect(pos, byte_size);
+	batch_quad(sv, SIMD_VIEWER_LAYER_BACKGROUND, rect, color);
+	return rect;
+}
+
+function Rectangle
+render_overlay_colored(SimdViewer* sv, Vector2 pos, int byte_size, Color color)
+{
+	Rectangle rect = box_rect(pos, byte_size);
+	batch_quad(sv, SIMD_VIEWER_LAYER_OVERLAY, rect, color);
+	return rect;
+}
+
+function void
+render_linebox_colored(SimdViewer* sv, Vector2 pos, int byte_size, Color color)
+{
+	Rectangle rect = { pos.x, pos.y + 1, (float)box_width(byte_size), BYTE_SIZE - 2 };
+	batch_lines(sv, SIMD_VIEWER_LAYER_BACKGROUND, rect, 1.0f, color);
+}
+
+function Rectangle
+render_box(SimdViewer* sv, Vector2 pos, int byte_size)
+{
+	Color c = LIGHTGRAY;
+	c.r += 20;
+	return render_box_colored(sv, pos, byte_size, c);
+}
+
+function Rectangle
+render_box_highlight(SimdViewer* sv, Vector2 pos, int byte_size, bool should_highlight)
+{
+	Color c = LIGHTGRAY;
+	c.r += 20;
+	if (should_highlight)
+	{
+		c.r = 255;
+		c.g += 30;
+	}
+	return render_box_colored(sv, pos, byte_size, c);
+}
+
+function void
+render_text_centered(SimdViewer* sv, Vector2 pos, const char* text, int width)
 {
-	return rtype >= REGISTER_TYPE_S8 && rtype <= REGISTER_TYPE_S64;
+	Vector2 measure = MeasureTextEx(sv->font, text, (float)sv->font.baseSize, 0);
+	batch_text(sv, Vector2Add(pos, (Vector2) { width / 2 - measure.x / 2, BYTE_SIZE / 2 - measure.y / 2 }), text);
 }
 
-function bool
-regtype_is_64bit(RegisterType rtype)
+function void
+render_text_rightalign(SimdViewer* sv, Vector2 pos, const char* text, Vector2 measure, int width)
 {
-	return rtype == REGISTER_TYPE_S64 || rtype == REGISTER_TYPE_U64;
+	batch_text(sv, Vector2Add(pos, (Vector2) { width - measure.x - 4, BYTE_SIZE / 2 - measure.y / 2 }), text);
+}
+
+function SimdLanes
+decode_lanes(AnyValue value)
+{
+	switch (value.register_size_bytes * 8)
+	{
+		case 128: return simd_lanes_from_128(value.i128);
+		case 256: return simd_lanes_from_256(value.i256);
+		case 512: return simd_lanes_from_512(value.i512);
+		default: assert(false);
+	}
+	return (SimdLanes) { 0 };
+}
+
+function void
+render_register(SimdViewer* sv, Vector2 pos, const AnyValue* any, RenderFlag flag, uint64_t matches)
+{
+	Font font = sv->font;
+	uint32_t highlight_size = sv->highlight_size;
+
+	if (flag & SIMD_VIEWER_RENDER_BORDER)
+	{
+		Rectangle border_rect = (Rectangle){ .x = pos.x - BORDER_SIZE, .y = pos.y - BORDER_SIZE, .width = (float)(box_width(any->register_size_bytes) + BORDER_SIZE * 2), BYTE_SIZE + BORDER_SIZE * 2 };
+		batch_lines(sv, SIMD_VIEWER_LAYER_BACKGROUND, border_rect, BORDER_SIZE, (Color) { 0x20, 0x20, 0x20, 0xff });
+	}
+
+	SimdLanes lanes = decode_lanes(*any);
+
+	uint16_t division_size = regtype_to_bytesize(any->type);
+	int lane_count = any->register_size_bytes / division_size;
+	const LaneCacheSlot* formatted = lane_cache_get(&sv->lane_cache, font, &lanes, any->type, any->register_size_bytes, flag & SIMD_VIEWER_RENDER_HEX, sv->frame_arena);
+
+	Vector2 render_position = pos;
+	for (int i = lane_count - 1; i >= 0; --i)
+	{
+		bool same = (matches >> i) & 1;
+		Rectangle boxrect = render_box_highlight(sv, render_position, division_size, same);
+		render_text_rightalign(sv, render_position, formatted->lane_text[i], formatted->lane_measure[i], box_width(division_size));
+
+		if (flag & SIMD_VIEWER_RENDER_MASK)
+		{
+			bool set = (any->lane_mask >> i) & 1;
+			if (!set)
+				render_overlay_colored(sv, render_position, division_size, (Color) { 0x20, 0x20, 0x20, 0x80 });
+			Rectangle strip = { boxrect.x, boxrect.y + BYTE_SIZE - MASK_STRIP_SIZE, boxrect.width, MASK_STRIP_SIZE };
+			batch_quad(sv, SIMD_VIEWER_LAYER_OVERLAY, strip, (set) ? LIME : DARKGRAY);
+		}
+
+		render_position = Vector2Add(render_position, (Vector2) { (BYTE_SIZE + SPACING) * division_size, 0 });
+	}
+
+	if (flag & SIMD_VIEWER_RENDER_HIGHLIGHT && highlight_size > 0)
+	{
+		Vector2 sz_pos = pos;
+		Color highlight_color = GOLD;
+		highlight_color.a = 60;
+
+		for (int i = 0; i < any->register_size_bytes / highlight_size; ++i)
+		{
+			if (i % 2 == 0)
+				render_overlay_colored(sv, sz_pos, highlight_size, highlight_color);
+			sz_pos = Vector2Add(sz_pos, (Vector2) { (BYTE_SIZE + SPACING)* highlight_size, 0 });
+		}
+	}
+}
+
+function void
+render_operation(SimdViewer* sv, Vector2 pos, const char* description, int byte_size, int register_size)
+{
+	Color redish = RED;
+	redish.a = 200;
+	render_box_colored(sv, pos, register_size, redish);
+
+	Vector2 inner_pos = pos;
+	for (int i = register_size / byte_size - 1; i >= 0; --i)
+	{
+		render_linebox_colored(sv, inner_pos, byte_size, (Color) { 0x50, 0x50, 0x50, 0x30 });
+		inner_pos = Vector2Add(inner_pos, (Vector2) { (float)((BYTE_SIZE + SPACING) * byte_size), 0 });
+	}
+
+	render_text_centered(sv, pos, description, box_width(register_size));
+}
+
+function void
+render_mask(SimdViewer* sv, Vector2 pos, uint64_t mask, int bit_count, int register_size)
+{
+	// Each bit takes the width of one lane of the register it sits beside
+	int lane_size = (register_size / bit_count > 0) ? register_size / bit_count : 1;
+	Vector2 render_position = pos;
+	for (int i = bit_count - 1; i >= 0; --i)
+	{
+		bool set = (mask >> i) & 1;
+		Rectangle strip = { render_position.x, render_position.y + BYTE_SIZE - MASK_STRIP_SIZE * 3, (float)box_width(lane_size), MASK_STRIP_SIZE * 3 };
+		batch_quad(sv, SIMD_VIEWER_LAYER_BACKGROUND, strip, (set) ? LIME : DARKGRAY);
+		render_text_centered(sv, render_position, (set) ? "1" : "0", box_width(lane_size));
+		render_position = Vector2Add(render_position, (Vector2) { (float)((BYTE_SIZE + SPACING) * lane_size), 0 });
+	}
+}
+
+static const int highlighter_sizes[] = {
+	sizeof(uint8_t),
+	sizeof(uint16_t),
+	sizeof(uint32_t),
+	sizeof(uint64_t),
+	sizeof(__m128i),
+	sizeof(__m256i),
+	sizeof(__m512i),
+};
+
+function void
+render_highlighter(SimdViewer* sv, Vector2 pos)
+{
+	Color overlay = (Color){ 50, 50, 50, 50 };
+	uint32_t register_size = sv->widest_register_size;
+	uint32_t hover_size = sv->highlighter_hover_size;
+	render_box_colored(sv, pos, register_size, ORANGE);
+
+	if (hover_size > 0)
+	{
+		overlay = ColorBrightness(overlay, -4.0f);
+		render_box_colored(sv, pos, hover_size, overlay);
+		render_linebox_colored(sv, pos, hover_size, overlay);
+		render_text_centered(sv, pos, TextFormat("Register %d bits", hover_size * 8), box_width(register_size));
+		return;
+	}
+
+	if (sv->highlight_size > 0)
+	{
+		render_linebox_colored(sv, pos, sv->highlight_size, RAYWHITE);
+	}
+
+	for (int i = 0; i < ARRAY_LENGTH(highlighter_sizes) && highlighter_sizes[i] < register_size; ++i)
+		render_box_colored(sv, pos, highlighter_sizes[i], overlay);
+}
+
+// ----------------------------------------------------------------------------------------------
+// Timing
+
+function inline uint64_t
+read_tsc(void)
+{
+	// rdtscp waits for the instructions before it, a step doesn't end before its last instruction
+	unsigned int processor;
+	return __rdtscp(&processor);
+}
+
+function int
+compare_u32(const void* a, const void* b)
+{
+	uint32_t x = *(const uint32_t*)a;
+	uint32_t y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+function void
+close_step(SimdViewer* sv, uint64_t tsc)
+{
+	if (!sv->timing_open)
+		return;
+	SimdViewerTiming* timing = &sv->timings[sv->timing_open - 1];
+	uint64_t cycles = tsc - sv->timing_start;
+	cycles = (cycles > sv->timing_excluded) ? cycles - sv->timing_excluded : 0;
+	timing->samples[timing->sample_count++ % SIMD_VIEWER_TIMING_SAMPLES] = (cycles > UINT32_MAX) ? UINT32_MAX : (uint32_t)cycles;
+	timing->dirty = true;
+	sv->timing_open = 0;
+}
+
+// The nth marker of every frame shares its samples, as long as it keeps the same name
+function void
+open_step(SimdViewer* sv, SimdViewerCommand* operation, uint64_t name_hash)
+{
+	if (sv->timing_operation == array_length(sv->timings))
+	{
+		SimdViewerTiming timing = { 0 };
+		array_push(sv->timings, timing);
+	}
+	SimdViewerTiming* timing = &sv->timings[sv->timing_operation++];
+	if (timing->name_hash != name_hash)
+	{
+		memset(timing, 0, sizeof(*timing));
+		timing->name_hash = name_hash;
+	}
+	operation->timing = sv->timing_operation;
+	sv->timing_open = sv->timing_operation;
+}
+
+// The last step ends at the flush
+function void
+finish_timing(SimdViewer* sv)
+{
+	close_step(sv, read_tsc());
+	sv->timing_operation = 0;
+
+	uint32_t sorted[SIMD_VIEWER_TIMING_SAMPLES];
+	for (uint32_t i = 0; i < array_length(sv->timings); ++i)
+	{
+		SimdViewerTiming* timing = &sv->timings[i];
+		if (!timing->dirty)
+			continue;
+		uint32_t count = (timing->sample_count < SIMD_VIEWER_TIMING_SAMPLES) ? timing->sample_count : SIMD_VIEWER_TIMING_SAMPLES;
+		memcpy(sorted, timing->samples, count * sizeof(*sorted));
+		qsort(sorted, count, sizeof(*sorted), compare_u32);
+		timing->min = sorted[0];
+		timing->median = sorted[count / 2];
+		timing->p99 = sorted[(count * 99) / 100];
+		timing->dirty = false;
+	}
 }
 
 function const char*
-fmt(bool hex, RegisterType rtype)
+operation_label(SimdViewer* sv, const SimdViewerCommand* command)
+{
+	const char* label = command->name;
+	SimdBenchResult bench;
+	if (sv->bench && simd_bench_get(sv->bench, command->name, &bench))
+		label = TextFormat("%s    lat %.1f  tp %.2f", label, bench.latency, bench.throughput);
+
+	if (!command->timing || command->timing > array_length(sv->timings) || !sv->timings[command->timing - 1].sample_count)
+		return label;
+	const SimdViewerTiming* timing = &sv->timings[command->timing - 1];
+	return TextFormat("%s    min %u  med %u  p99 %u cycles", label, timing->min, timing->median, timing->p99);
+}
+
+// ----------------------------------------------------------------------------------------------
+// Command buffer
+
+function uint64_t
+hash_bytes(uint64_t hash, const void* data, size_t size)
 {
-	if (hex)
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; ++i)
 	{
-		return (regtype_is_64bit(rtype)) ? "0x%llx" : "0x%x";
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
 	}
+	return hash;
+}
+
+function uint64_t
+hash_command(uint64_t hash, const SimdViewerCommand* command)
+{
+	hash = hash_bytes(hash, &command->kind, sizeof(command->kind));
+	hash = hash_bytes(hash, &command->flags, sizeof(command->flags));
+	hash = hash_bytes(hash, &command->division, sizeof(command->division));
+	hash = hash_bytes(hash, &command->register_size, sizeof(command->register_size));
+	hash = hash_bytes(hash, &command->bit_count, sizeof(command->bit_count));
+	hash = hash_bytes(hash, &command->value.type, sizeof(command->value.type));
+	hash = hash_bytes(hash, &command->value.lane_mask, sizeof(command->value.lane_mask));
+	hash = hash_bytes(hash, &command->value.i512, command->value.register_size_bytes);
+	hash = hash_bytes(hash, &command->thread, sizeof(command->thread));
+	hash = hash_bytes(hash, &command->immediate, sizeof(command->immediate));
+	if (command->name)
+		hash = hash_bytes(hash, command->name, strlen(command->name));
+	return hash;
+}
+
+function SimdViewerCommand*
+push_command(SimdViewer* sv, SimdViewerCommandKind kind)
+{
+	if (sv->timing_enabled)
+		sv->timing_pushed = read_tsc();
+
+	// AnyValue holds zmm registers, so commands need 64 byte alignment the arena doesn't give
+	uintptr_t at = (uintptr_t)arena_alloc(sv->command_arena, sizeof(SimdViewerCommand) + sizeof(__m512i) - 1);
+	SimdViewerCommand* command = (SimdViewerCommand*)((at + sizeof(__m512i) - 1) & ~(uintptr_t)(sizeof(__m512i) - 1));
+	memset(command, 0, sizeof(*command)); // cleared arenas hand back dirty memory
+	command->kind = kind;
+	command->thread = sv->push_thread;
+	if (sv->push_thread > sv->thread_count)
+		sv->thread_count = sv->push_thread;
+
+	if (sv->last_command)
+		sv->last_command->next = command;
 	else
+		sv->first_command = command;
+	sv->last_command = command;
+	sv->stack_index++;
+
+	return command;
+}
+
+function void
+commit_command(SimdViewer* sv, const SimdViewerCommand* command)
+{
+	sv->command_hash = hash_command(sv->command_hash, command);
+	if (sv->timing_open)
+		sv->timing_excluded += read_tsc() - sv->timing_pushed;
+}
+
+function void
+push_register(SimdViewer* sv, AnyValue value, RenderFlag flags)
+{
+	SimdViewerCommand* command = push_command(sv, SIMD_VIEWER_COMMAND_REGISTER);
+	command->value = value;
+	command->flags = flags;
+	command->register_size = value.register_size_bytes;
+	commit_command(sv, command);
+
+	sv->last_register_size = value.register_size_bytes;
+}
+
+function void
+push_mask(SimdViewer* sv, uint64_t mask, uint32_t bit_count)
+{
+	SimdViewerCommand* command = push_command(sv, SIMD_VIEWER_COMMAND_MASK);
+	command->value.lane_mask = mask;
+	// At most one bit per byte of the register it sits beside, the rest would be drawn past its width
+	command->bit_count = (bit_count < sv->last_register_size) ? bit_count : sv->last_register_size;
+	command->register_size = sv->last_register_size;
+	commit_command(sv, command);
+}
+
+// ----------------------------------------------------------------------------------------------
+// History
+
+function SimdViewerCommand*
+history_copy(SimdViewer* sv, const SimdViewerCommand* command)
+{
+	uintptr_t at = (uintptr_t)arena_alloc(sv->history_arena, sizeof(SimdViewerCommand) + sizeof(__m512i) - 1);
+	SimdViewerCommand* copy = (SimdViewerCommand*)((at + sizeof(__m512i) - 1) & ~(uintptr_t)(sizeof(__m512i) - 1));
+	*copy = *command;
+	copy->next = 0;
+	if (command->name)
+	{
+		size_t length = strlen(command->name) + 1;
+		copy->name = memcpy(arena_alloc(sv->history_arena, length), command->name, length);
+	}
+	return copy;
+}
+
+// Keeps the newer half of the frames. The arena can only be freed whole, so the kept commands
+// move into a new one.
+function void
+drop_old_history(SimdViewer* sv)
+{
+	uint64_t frame_count = array_length(sv->history_frames);
+	uint64_t kept = frame_count / 2;
+	uint64_t dropped = sv->history_frames[kept].first;
+	if (dropped == 0)
+		return;
+
+	Light_Arena* old_arena = sv->history_arena;
+	sv->history_arena = arena_create(SIMD_VIEWER_HISTORY_ARENA_SIZE);
+	uint64_t push_count = array_length(sv->history_commands);
+	for (uint64_t i = dropped; i < push_count; ++i)
+		sv->history_commands[i - dropped] = history_copy(sv, sv->history_commands[i]);
+	array_length(sv->history_commands) = push_count - dropped;
+	for (uint64_t i = kept; i < frame_count; ++i)
 	{
-		if(regtype_is_signed(rtype))
-			return (regtype_is_64bit(rtype)) ? "%lld" : "%d";
+		sv->history_frames[i - kept] = sv->history_frames[i];
+		sv->history_frames[i - kept].first -= dropped;
+	}
+	array_length(sv->history_frames) = frame_count - kept;
+	arena_free(old_arena);
+
+	// Rows built from the history point into the old arena
+	if (sv->history_cursor >= 0)
+		sv->history_cursor = ((uint64_t)sv->history_cursor < dropped) ? 0 : sv->history_cursor - (int64_t)dropped;
+	sv->layout_hash = 0;
+}
+
+// Consecutive flushes of the same commands are one frame, so an idle loop doesn't grow the history
+function void
+record_history(SimdViewer* sv)
+{
+	if (!sv->history_enabled || !sv->first_command || sv->command_hash == sv->history_hash)
+		return;
+
+	HistoryFrame frame = { array_length(sv->history_commands), 0, sv->frame_index };
+	for (SimdViewerCommand* command = sv->first_command; command; command = command->next)
+	{
+		array_push(sv->history_commands, history_copy(sv, command));
+		frame.count++;
+	}
+	array_push(sv->history_frames, frame);
+	sv->history_hash = sv->command_hash;
+	if (array_length(sv->history_commands) > SIMD_VIEWER_HISTORY_MAX_PUSHES)
+		drop_old_history(sv);
+}
+
+// Frame holding a push, the frames are sorted by their first push
+function uint64_t
+history_frame_at(SimdViewer* sv, uint64_t push)
+{
+	uint64_t low = 0;
+	uint64_t high = array_length(sv->history_frames);
+	while (high - low > 1)
+	{
+		uint64_t mid = low + (high - low) / 2;
+		if (sv->history_frames[mid].first <= push)
+			low = mid;
 		else
-			return (regtype_is_64bit(rtype)) ? "%llu" : "%u";
+			high = mid;
 	}
+	return low;
 }
 
-function int
-regtype_to_bytesize(RegisterType regtype)
+// What the rows are built from, the live commands or the history up to the cursor
+function uint64_t
+content_hash(SimdViewer* sv)
 {
-	switch (regtype)
+	uint64_t hash = (sv->history_cursor < 0) ? sv->command_hash : hash_bytes(FNV_OFFSET_BASIS ^ 1, &sv->history_cursor, sizeof(sv->history_cursor));
+	return hash_bytes(hash, &sv->thread_filter, sizeof(sv->thread_filter));
+}
+
+function void
+layout_row(SimdViewer* sv, SimdViewerCommand* command)
+{
+	if (sv->thread_filter >= 0 && command->thread != sv->thread_filter)
+		return;
+	array_push(sv->rows, command);
+	array_push(sv->hover_matches, 0);
+	if (command->kind == SIMD_VIEWER_COMMAND_REGISTER && command->register_size > sv->widest_register_size)
+		sv->widest_register_size = command->register_size;
+}
+
+// A shuffle banner reads the registers right above it and writes the one right below
+function void
+build_flows(SimdViewer* sv)
+{
+	array_clear(sv->flows);
+	int32_t row_count = (int32_t)array_length(sv->rows);
+	for (int32_t row = 1; row + 1 < row_count; ++row)
 	{
-	default:
-		case REGISTER_TYPE_S8:  case REGISTER_TYPE_U8: return sizeof(int8_t);
-		case REGISTER_TYPE_S16: case REGISTER_TYPE_U16: return sizeof(int16_t);
-		case REGISTER_TYPE_S32: case REGISTER_TYPE_U32: return sizeof(int32_t);
-		case REGISTER_TYPE_S64: case REGISTER_TYPE_U64: return sizeof(int64_t);
-		case REGISTER_TYPE_F32: return sizeof(float);
-		case REGISTER_TYPE_F64: return sizeof(double);
+		const SimdViewerCommand* operation = sv->rows[row];
+		const SimdViewerCommand* result = sv->rows[row + 1];
+		if (operation->kind != SIMD_VIEWER_COMMAND_OPERATION || result->kind != SIMD_VIEWER_COMMAND_REGISTER)
+			continue;
+
+		int32_t first = row;
+		while (first > 0 && row - first < SIMD_FLOW_MAX_INPUTS && sv->rows[first - 1]->kind == SIMD_VIEWER_COMMAND_REGISTER)
+			first--;
+		__m512i inputs[SIMD_FLOW_MAX_INPUTS];
+		for (int32_t i = first; i < row; ++i)
+			inputs[i - first] = sv->rows[i]->value.i512;
+
+		SimdViewerFlow flow = { 0 };
+		if (!simd_flow_get(&sv->flow_cache, operation->name, operation->immediate, inputs, row - first, &flow.map) ||
+			flow.map.size != result->value.register_size_bytes)
+			continue;
+
+		// The operands are the registers closest to the banner
+		bool sizes_match = true;
+		for (uint32_t k = 0; k < flow.map.input_count; ++k)
+		{
+			flow.inputs[k] = row - (int32_t)flow.map.input_count + (int32_t)k;
+			sizes_match &= sv->rows[flow.inputs[k]]->value.register_size_bytes == flow.map.size;
+		}
+		flow.result = row + 1;
+		if (sizes_match)
+			array_push(sv->flows, flow);
+	}
+}
+
+// Rows are rebuilt only when the recorded commands changed
+function void
+layout_commands(SimdViewer* sv)
+{
+	array_clear(sv->rows);
+	array_clear(sv->hover_matches);
+	array_clear(sv->matched_rows);
+	sv->widest_register_size = sizeof(__m256i);
+	if (sv->history_cursor >= 0)
+	{
+		// Only the frame under the cursor is laid out, up to the push the cursor is on
+		const HistoryFrame* frame = &sv->history_frames[history_frame_at(sv, sv->history_cursor)];
+		for (uint64_t i = frame->first; i <= (uint64_t)sv->history_cursor; ++i)
+			layout_row(sv, sv->history_commands[i]);
+	}
+	else
+	{
+		for (SimdViewerCommand* command = sv->first_command; command; command = command->next)
+			layout_row(sv, command);
+	}
+	build_flows(sv);
+	sv->layout_hash = content_hash(sv);
+	sv->value_index_stale = true;
+	simd_debug_push(sv->debug_events, SIMD_DEBUG_EVENT_RELAYOUT, sv->frame_index, (int32_t)array_length(sv->rows), 0, 0);
+
+	// Matches referred to the old rows
+	sv->matched_row = -1;
+	sv->matched_index = -1;
+}
+
+// Rows are laid out in content space, the screen shows them shifted up by the scroll offset
+function Vector2
+row_position(SimdViewer* sv, int32_t row)
+{
+	return Vector2Subtract(line_position(row), (Vector2) { 0, sv->scroll_y });
+}
+
+function float
+content_height(SimdViewer* sv)
+{
+	return line_position((int)array_length(sv->rows)).y;
+}
+
+function float
+max_scroll(SimdViewer* sv, int height)
+{
+	float max = content_height(sv) - height;
+	return (max > 0) ? max : 0;
+}
+
+function Rectangle
+scrollbar_thumb(SimdViewer* sv, int width, int height)
+{
+	float thumb_height = fmaxf(SCROLLBAR_MIN_THUMB, height * (height / content_height(sv)));
+	float max = max_scroll(sv, height);
+	float t = (max > 0) ? sv->scroll_y / max : 0;
+	return (Rectangle) { (float)(width - SCROLLBAR_WIDTH), t * (height - thumb_height), SCROLLBAR_WIDTH, thumb_height };
+}
+
+function void
+update_scroll(SimdViewer* sv, Vector2 mouse, int width, int height)
+{
+	float stride = BYTE_SIZE + Y_SPACING;
+	float max = max_scroll(sv, height);
+	float scroll = sv->scroll_y - GetMouseWheelMove() * stride * 3;
+	if (IsKeyPressed(KEY_PAGE_DOWN)) scroll += height - stride;
+	if (IsKeyPressed(KEY_PAGE_UP)) scroll -= height - stride;
+	if (IsKeyPressed(KEY_HOME)) scroll = 0;
+	if (IsKeyPressed(KEY_END)) scroll = max;
+
+	// Dragging the thumb maps the mouse back onto the scroll range
+	Rectangle thumb = scrollbar_thumb(sv, width, height);
+	if (max > 0 && IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(mouse, thumb))
+		sv->scroll_drag = mouse.y - thumb.y;
+	if (!IsMouseButtonDown(MOUSE_LEFT_BUTTON))
+		sv->scroll_drag = -1;
+	if (sv->scroll_drag >= 0 && height > thumb.height)
+		scroll = (mouse.y - sv->scroll_drag) / (height - thumb.height) * max;
+
+	// Whole pixels keep the text sharp
+	sv->scroll_y = floorf(Clamp(scroll, 0, max));
+}
+
+// Row under a screen position, rows are evenly spaced so this doesn't walk the commands
+function int32_t
+row_at(SimdViewer* sv, Vector2 position)
+{
+	Vector2 origin = line_position(0);
+	if (position.y >= sv->view_height)
+		return -1;
+	position.y += sv->scroll_y;
+	if (position.y < origin.y || position.x < origin.x)
+		return -1;
+
+	int32_t row = (int32_t)((position.y - origin.y) / (BYTE_SIZE + Y_SPACING));
+	if (position.y - line_position(row).y >= BYTE_SIZE || row >= (int32_t)array_length(sv->rows))
+		return -1;
+	return row;
+}
+
+function void
+update_hovered(SimdViewer* sv, Vector2 mouse)
+{
+	sv->hovered.row = -1;
+	sv->hovered.index = -1;
+	sv->hovered.value = (AnyValue){ 0 };
+
+	int32_t row = row_at(sv, mouse);
+	if (row < 0 || sv->rows[row]->kind != SIMD_VIEWER_COMMAND_REGISTER)
+		return;
+
+	const AnyValue* value = &sv->rows[row]->value;
+	int32_t column = (int32_t)((mouse.x - line_position(row).x) / (BYTE_SIZE + SPACING));
+	if (column >= (int32_t)value->register_size_bytes)
+		return;
+
+	// Lanes are laid out from the highest on the left
+	sv->hovered.row = row;
+	sv->hovered.index = (value->register_size_bytes - 1 - column) / regtype_to_bytesize(value->type);
+	sv->hovered.value = *value;
+	sv->hovered.lanes = decode_lanes(*value);
+}
+
+function void
+build_value_index(SimdViewer* sv)
+{
+	value_index_clear(&sv->value_index);
+	for (int32_t row = 0; row < (int32_t)array_length(sv->rows); ++row)
+	{
+		const SimdViewerCommand* command = sv->rows[row];
+		if (command->kind != SIMD_VIEWER_COMMAND_REGISTER)
+			continue;
+		SimdLanes lanes = decode_lanes(command->value);
+		value_index_add(&sv->value_index, row, &lanes, command->value.register_size_bytes, regtype_to_bytesize(command->value.type));
+	}
+	value_index_build(&sv->value_index);
+	sv->value_index_stale = false;
+}
+
+// Marks every lane with the same bits as the hovered one, only the matching lanes are visited
+function void
+update_hover_matches(SimdViewer* sv)
+{
+	if (sv->hovered.row == sv->matched_row && sv->hovered.index == sv->matched_index)
+		return;
+
+	for (size_t i = 0; i < array_length(sv->matched_rows); ++i)
+		sv->hover_matches[sv->matched_rows[i]] = 0;
+	array_clear(sv->matched_rows);
+	sv->matched_row = sv->hovered.row;
+	sv->matched_index = sv->hovered.index;
+	if (sv->hovered.row < 0)
+		return;
+
+	// Every row is decoded for the index, so it is only built once something is hovered
+	if (sv->value_index_stale)
+		build_value_index(sv);
+
+	uint32_t lane_size = regtype_to_bytesize(sv->hovered.value.type);
+	uint64_t bits = simd_lane_bits(&sv->hovered.lanes, sv->hovered.index, lane_size);
+	const ValueIndex* index = &sv->value_index;
+	for (int32_t entry = value_index_first(index, bits, lane_size); entry >= 0; entry = value_index_next(index, entry))
+	{
+		int32_t row = index->entries[entry].row;
+		if (sv->hover_matches[row] == 0)
+			array_push(sv->matched_rows, row);
+		sv->hover_matches[row] |= 1ull << index->entries[entry].lane;
+		simd_debug_push(sv->debug_events, SIMD_DEBUG_EVENT_HOVER_MATCH, sv->frame_index, row, index->entries[entry].lane, bits);
+	}
+}
+
+function void
+update_highlighter(SimdViewer* sv, Vector2 mouse)
+{
+	sv->highlighter_hover_size = 0;
+
+	int32_t row = row_at(sv, mouse);
+	if (row < 0 || sv->rows[row]->kind != SIMD_VIEWER_COMMAND_HIGHLIGHTER)
+		return;
+
+	Vector2 pos = row_position(sv, row);
+	for (int i = 0; i < ARRAY_LENGTH(highlighter_sizes) && highlighter_sizes[i] <= sv->widest_register_size; ++i)
+	{
+		if (mouse.x < pos.x + box_width(highlighter_sizes[i]))
+		{
+			sv->highlighter_hover_size = highlighter_sizes[i];
+			if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
+				sv->highlight_size = highlighter_sizes[i];
+			if (IsMouseButtonPressed(MOUSE_RIGHT_BUTTON))
+				sv->highlight_size = 0;
+			return;
+		}
+	}
+}
+
+function Rectangle
+timeline_rect(SimdViewer* sv, int width)
+{
+	return (Rectangle) { 0, sv->view_height, (float)width, TIMELINE_HEIGHT };
+}
+
+// Tab steps through all threads, then each thread on its own
+function void
+update_thread_filter(SimdViewer* sv)
+{
+	if (sv->thread_count == 0 || !IsKeyPressed(KEY_TAB))
+		return;
+	int32_t filter = sv->thread_filter + 1;
+	simd_viewer_set_thread_filter(sv, (filter == 0) ? 1 : (filter > sv->thread_count) ? -1 : filter);
+}
+
+function void
+update_timeline(SimdViewer* sv, Vector2 mouse, int width)
+{
+	int64_t frame_count = (int64_t)array_length(sv->history_frames);
+	if (!sv->history_enabled || frame_count == 0)
+		return;
+
+	// The live view shows all of the last frame, stepping back starts from its last push
+	int64_t push_count = (int64_t)array_length(sv->history_commands);
+	int64_t cursor = (sv->history_cursor < 0) ? push_count - 1 : sv->history_cursor;
+	if (IsKeyPressed(KEY_LEFT) || IsKeyPressedRepeat(KEY_LEFT))
+		cursor = (cursor > 0) ? cursor - 1 : 0;
+	if (IsKeyPressed(KEY_RIGHT) || IsKeyPressedRepeat(KEY_RIGHT))
+		cursor = cursor + 1;
+
+	Rectangle rect = timeline_rect(sv, width);
+	if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(mouse, rect))
+		sv->timeline_drag = true;
+	if (!IsMouseButtonDown(MOUSE_LEFT_BUTTON))
+		sv->timeline_drag = false;
+	if (sv->timeline_drag)
+	{
+		// Dragging moves by frame and shows the whole frame
+		int64_t frame = (int64_t)((mouse.x - rect.x) / rect.width * frame_count);
+		frame = (frame < 0) ? 0 : (frame >= frame_count) ? frame_count - 1 : frame;
+		cursor = (int64_t)(sv->history_frames[frame].first + sv->history_frames[frame].count) - 1;
+	}
+
+	sv->history_cursor = (cursor >= push_count - 1) ? -1 : cursor;
+}
+
+// Everything that changes what a frame looks like, the cached frame is redrawn when it changes
+function uint64_t
+view_state_hash(SimdViewer* sv)
+{
+	uint64_t hash = sv->layout_hash;
+	hash = hash_bytes(hash, &sv->hovered.row, sizeof(sv->hovered.row));
+	hash = hash_bytes(hash, &sv->hovered.index, sizeof(sv->hovered.index));
+	hash = hash_bytes(hash, &sv->highlight_size, sizeof(sv->highlight_size));
+	hash = hash_bytes(hash, &sv->highlighter_hover_size, sizeof(sv->highlighter_hover_size));
+	hash = hash_bytes(hash, &sv->scroll_y, sizeof(sv->scroll_y));
+	hash = hash_bytes(hash, &sv->scroll_drag, sizeof(sv->scroll_drag));
+	hash = hash_bytes(hash, &sv->view_height, sizeof(sv->view_height));
+	if (sv->history_enabled)
+	{
+		uint64_t frame_count = array_length(sv->history_frames);
+		hash = hash_bytes(hash, &frame_count, sizeof(frame_count));
+	}
+	for (uint32_t i = 0; i < array_length(sv->timings); ++i)
+		hash = hash_bytes(hash, &sv->timings[i].min, sizeof(uint32_t) * 3);
+	hash = hash_bytes(hash, &sv->bench, sizeof(sv->bench));
+	hash = hash_bytes(hash, &sv->show_flow, sizeof(sv->show_flow));
+	return hash;
+}
+
+// Pushes per frame along the whole history, read from the frame ranges so no command is touched
+function void
+render_timeline(SimdViewer* sv, int width)
+{
+	Rectangle rect = timeline_rect(sv, width);
+	batch_quad(sv, SIMD_VIEWER_LAYER_BACKGROUND, rect, (Color) { 0x30, 0x30, 0x30, 0xff });
+
+	uint64_t frame_count = array_length(sv->history_frames);
+	if (frame_count == 0)
+		return;
+
+	const HistoryFrame* frames = sv->history_frames;
+	float max_density = 0;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int column = 0; column < width; ++column)
+		{
+			uint64_t first = (uint64_t)column * frame_count / width;
+			uint64_t last = (uint64_t)(column + 1) * frame_count / width;
+			if (last <= first)
+				last = first + 1;
+			uint64_t pushes = frames[last - 1].first + frames[last - 1].count - frames[first].first;
+			float density = (float)pushes / (float)(last - first);
+			if (pass == 0)
+			{
+				max_density = fmaxf(max_density, density);
+				continue;
+			}
+			float bar = density / max_density * (TIMELINE_HEIGHT - 8);
+			batch_quad(sv, SIMD_VIEWER_LAYER_BACKGROUND, (Rectangle) { (float)column, rect.y + rect.height - 4 - bar, 1, bar }, (Color) { 0x00, 0x9e, 0x2f, 0xff });
+		}
+	}
+
+	uint64_t push_count = array_length(sv->history_commands);
+	uint64_t cursor = (sv->history_cursor < 0) ? push_count - 1 : (uint64_t)sv->history_cursor;
+	uint64_t frame = history_frame_at(sv, cursor);
+	float x = (frame + 0.5f) * width / frame_count;
+	batch_quad(sv, SIMD_VIEWER_LAYER_OVERLAY, (Rectangle) { x - 1, rect.y, 2, rect.height }, GOLD);
+
+	const char* label = TextFormat("frame %llu/%llu  push %llu/%llu%s", (unsigned long long)frame + 1, (unsigned long long)frame_count,
+		(unsigned long long)(cursor - frames[frame].first + 1), (unsigned long long)frames[frame].count, (sv->history_cursor < 0) ? "  live" : "");
+	Vector2 measure = MeasureTextEx(sv->font, label, (float)sv->font.baseSize, 0);
+	batch_quad(sv, SIMD_VIEWER_LAYER_BACKGROUND, (Rectangle) { rect.x + 4, rect.y + 4, measure.x + 8, measure.y }, LIGHTGRAY);
+	batch_text(sv, (Vector2) { rect.x + 8, rect.y + 4 }, label);
+}
+
+// Every data operand lane gets its own hue
+function Color
+flow_color(uint32_t lane, uint32_t lane_total)
+{
+	Color color = ColorFromHSV(360.0f * lane / lane_total, 0.7f, 1.0f);
+	color.a = 110;
+	return color;
+}
+
+// Lanes are laid out from the highest on the left
+function Vector2
+lane_position(SimdViewer* sv, int32_t row, uint32_t byte, uint32_t lane_size)
+{
+	uint32_t register_size = sv->rows[row]->value.register_size_bytes;
+	uint32_t first = byte - byte % lane_size;
+	return Vector2Add(row_position(sv, row), (Vector2) { (float)((register_size - first - lane_size) * (BYTE_SIZE + SPACING)), 0 });
+}
+
+function void
+outline_lane(SimdViewer* sv, int32_t row, uint32_t byte, uint32_t lane_size)
+{
+	batch_lines(sv, SIMD_VIEWER_LAYER_OVERLAY, box_rect(lane_position(sv, row, byte, lane_size), lane_size), 3.0f, RAYWHITE);
+}
+
+// A result lane takes the colour of the lane its lowest byte came from
+function void
+render_flow(SimdViewer* sv, const SimdViewerFlow* flow, int32_t first, int32_t last)
+{
+	const SimdFlowMap* map = &flow->map;
+	uint32_t lane_sizes[SIMD_FLOW_MAX_INPUTS];
+	uint32_t lane_base[SIMD_FLOW_MAX_INPUTS];
+	uint32_t lane_total = 0;
+	for (uint32_t k = 0; k < map->input_count; ++k)
+	{
+		lane_sizes[k] = regtype_to_bytesize(sv->rows[flow->inputs[k]]->value.type);
+		lane_base[k] = lane_total;
+		if ((int32_t)k != map->control)
+			lane_total += map->size / lane_sizes[k];
+	}
+
+	for (uint32_t k = 0; k < map->input_count; ++k)
+	{
+		int32_t row = flow->inputs[k];
+		if ((int32_t)k == map->control || row < first || row >= last)
+			continue;
+		for (uint32_t byte = 0; byte < map->size; byte += lane_sizes[k])
+			render_overlay_colored(sv, lane_position(sv, row, byte, lane_sizes[k]), lane_sizes[k], flow_color(lane_base[k] + byte / lane_sizes[k], lane_total));
+	}
+
+	uint32_t result_lane = regtype_to_bytesize(sv->rows[flow->result]->value.type);
+	if (flow->result >= first && flow->result < last)
+	{
+		for (uint32_t byte = 0; byte < map->size; byte += result_lane)
+		{
+			uint8_t source = map->source[byte];
+			uint32_t k = source >> 6;
+			Color color = (source == SIMD_FLOW_ZERO) ? (Color) { 0x20, 0x20, 0x20, 0x80 } : flow_color(lane_base[k] + (source & 63) / lane_sizes[k], lane_total);
+			render_overlay_colored(sv, lane_position(sv, flow->result, byte, result_lane), result_lane, color);
+		}
+	}
+
+	// Hovering a result lane outlines its source, hovering an operand lane the result lanes it feeds
+	int32_t hovered = sv->hovered.row;
+	if (hovered == flow->result && sv->hovered.index >= 0)
+	{
+		uint8_t source = map->source[sv->hovered.index * result_lane];
+		if (source != SIMD_FLOW_ZERO)
+			outline_lane(sv, flow->inputs[source >> 6], source & 63, lane_sizes[source >> 6]);
+	}
+	for (uint32_t k = 0; k < map->input_count; ++k)
+	{
+		if (hovered != flow->inputs[k] || (int32_t)k == map->control || sv->hovered.index < 0)
+			continue;
+		uint32_t lane = (uint32_t)sv->hovered.index;
+		for (uint32_t byte = 0; byte < map->size; byte += result_lane)
+		{
+			uint8_t source = map->source[byte];
+			if (source != SIMD_FLOW_ZERO && (source >> 6) == k && (source & 63) / lane_sizes[k] == lane)
+				outline_lane(sv, flow->result, byte, result_lane);
+		}
+	}
+}
+
+function void
+render_commands(SimdViewer* sv, SimdViewerBackend* backend, int width, int height)
+{
+	// Rows stop above the timeline
+	height = (int)sv->view_height;
+
+	// Only the rows intersecting the screen are decoded, formatted and drawn
+	float stride = BYTE_SIZE + Y_SPACING;
+	float top = sv->scroll_y - line_position(0).y - BORDER_SIZE;
+	int32_t first = (top > 0) ? (int32_t)(top / stride) : 0;
+	int32_t last = (int32_t)((top + height + BORDER_SIZE * 2) / stride) + 1;
+	if (last > (int32_t)array_length(sv->rows))
+		last = (int32_t)array_length(sv->rows);
+
+	for (int32_t row = first; row < last; ++row)
+	{
+		const SimdViewerCommand* command = sv->rows[row];
+		Vector2 pos = row_position(sv, row);
+		switch (command->kind)
+		{
+			case SIMD_VIEWER_COMMAND_REGISTER:
+				render_register(sv, pos, &command->value, command->flags, sv->hover_matches[row]);
+				break;
+			case SIMD_VIEWER_COMMAND_OPERATION:
+				render_operation(sv, pos, operation_label(sv, command), regtype_to_bytesize(command->division), command->register_size);
+				break;
+			case SIMD_VIEWER_COMMAND_MASK:
+				render_mask(sv, pos, command->value.lane_mask, command->bit_count, command->register_size);
+				break;
+			case SIMD_VIEWER_COMMAND_HIGHLIGHTER:
+				render_highlighter(sv, pos);
+				break;
+			default: break;
+		}
+	}
+
+	for (uint32_t i = 0; sv->show_flow && i < array_length(sv->flows); ++i)
+		render_flow(sv, &sv->flows[i], first, last);
+
+	if (max_scroll(sv, height) > 0)
+	{
+		batch_quad(sv, SIMD_VIEWER_LAYER_OVERLAY, (Rectangle) { (float)(width - SCROLLBAR_WIDTH), 0, SCROLLBAR_WIDTH, (float)height }, (Color) { 0x30, 0x30, 0x30, 0xff });
+		batch_quad(sv, SIMD_VIEWER_LAYER_OVERLAY, scrollbar_thumb(sv, width, height), (sv->scroll_drag >= 0) ? RAYWHITE : LIGHTGRAY);
+	}
+
+	if (sv->thread_filter >= 0)
+	{
+		const char* label = TextFormat("thread %d/%d", sv->thread_filter, sv->thread_count);
+		Vector2 measure = MeasureTextEx(sv->font, label, (float)sv->font.baseSize, 0);
+		Rectangle rect = { width - SCROLLBAR_WIDTH - measure.x - 12, 4, measure.x + 8, measure.y };
+		batch_quad(sv, SIMD_VIEWER_LAYER_BACKGROUND, rect, GOLD);
+		batch_text(sv, (Vector2) { rect.x + 4, rect.y }, label);
+	}
+
+	submit_batch(sv, backend);
+
+	// Second batch, so rows reaching under the timeline don't draw their text over it
+	if (sv->history_enabled)
+	{
+		render_timeline(sv, width);
+		submit_batch(sv, backend);
 	}
 }
 
-function Vector2
-line_position(int index)
+// Latest debug events over the bottom of the screen, drawn every frame on top of the cached one
+function void
+render_debug_overlay(SimdViewer* sv, int width, int height)
+{
+	SimdDebugEvent events[DEBUG_OVERLAY_LINES];
+	uint32_t count = simd_debug_read(sv->debug_events, events, ARRAY_LENGTH(events));
+
+	float line_height = (float)sv->font.baseSize;
+	Rectangle panel = { 0, height - line_height * DEBUG_OVERLAY_LINES - 8, (float)width, line_height * DEBUG_OVERLAY_LINES + 8 };
+	DrawRectangleRec(panel, (Color) { 0x10, 0x10, 0x10, 0xd0 });
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		char line[128];
+		simd_debug_format(&events[i], line, sizeof(line));
+		DrawTextEx(sv->font, line, (Vector2) { panel.x + 4, panel.y + 4 + line_height * i }, line_height, 0, RAYWHITE);
+	}
+}
+
+// Initialization
+function void
+init_state(SimdViewer* simd_viewer)
+{
+	simd_viewer->default_render_flags = 0;
+	simd_viewer->highlight_size = 0;
+	simd_viewer->hovered.row = -1;
+	simd_viewer->hovered.index = -1;
+	simd_viewer->frame_arena = arena_create(SIMD_VIEWER_FRAME_ARENA_SIZE);
+	lane_cache_init(&simd_viewer->lane_cache, LANE_CACHE_DEFAULT_CAPACITY);
+
+	simd_viewer->retained = false;
+	simd_viewer->command_arena = arena_create(SIMD_VIEWER_COMMAND_ARENA_SIZE);
+	simd_viewer->rows = array_new(SimdViewerCommand*);
+	simd_viewer->hover_matches = array_new(uint64_t);
+	simd_viewer->matched_rows = array_new(int32_t);
+	value_index_init(&simd_viewer->value_index);
+	simd_viewer->matched_row = -1;
+	simd_viewer->matched_index = -1;
+	for (int layer = 0; layer < SIMD_VIEWER_LAYER_COUNT; ++layer)
+		simd_viewer->quads[layer] = array_new(BatchQuad);
+	simd_viewer->texts = array_new(BatchText);
+	simd_viewer->target = (RenderTexture2D){ 0 };
+	simd_viewer->view_hash = 0;
+	simd_viewer->frame_index = 0;
+	simd_viewer->history_enabled = false;
+	simd_viewer->history_arena = 0;
+	simd_viewer->history_commands = array_new(SimdViewerCommand*);
+	simd_viewer->history_frames = array_new(HistoryFrame);
+	simd_viewer->history_hash = 0;
+	simd_viewer->history_cursor = -1;
+	simd_viewer->timeline_drag = false;
+	simd_viewer->view_height = 0;
+	simd_viewer->scroll_y = 0;
+	simd_viewer->scroll_drag = -1;
+	simd_viewer->idle = false;
+	simd_viewer->event_waiting = false;
+	simd_viewer->redraw_requested = false;
+	simd_viewer->debug_events = 0;
+	simd_viewer->show_debug_overlay = false;
+	simd_viewer->push_thread = 0;
+	simd_viewer->thread_count = 0;
+	simd_viewer->thread_filter = -1;
+	simd_viewer->timing_enabled = false;
+	simd_viewer->timings = array_new(SimdViewerTiming);
+	simd_viewer->timing_operation = 0;
+	simd_viewer->timing_open = 0;
+	simd_viewer->bench = 0;
+	simd_viewer->show_flow = false;
+	simd_flow_cache_init(&simd_viewer->flow_cache);
+	simd_viewer->flows = array_new(SimdViewerFlow);
+	simd_viewer_clear(simd_viewer);
+}
+
+void 
+simd_viewer_init(SimdViewer* simd_viewer)
+{
+	simd_viewer->font = LoadFontEx(SIMD_VIEWER_FONT_PATH, SIMD_VIEWER_FONT_SIZE, 0, SIMD_VIEWER_FONT_GLYPHS);
+	init_state(simd_viewer);
+}
+
+void
+simd_viewer_init_headless(SimdViewer* simd_viewer)
+{
+	simd_viewer->font = simd_software_load_font(SIMD_VIEWER_FONT_PATH, SIMD_VIEWER_FONT_SIZE, SIMD_VIEWER_FONT_GLYPHS);
+	init_state(simd_viewer);
+}
+
+void
+simd_viewer_free(SimdViewer* simd_viewer)
+{
+	// A headless font never got a texture
+	if (simd_viewer->font.texture.id != 0)
+		UnloadFont(simd_viewer->font);
+	else
+		simd_software_unload_font(simd_viewer->font);
+	if (simd_viewer->target.id != 0)
+		UnloadRenderTexture(simd_viewer->target);
+
+	arena_free(simd_viewer->frame_arena);
+	arena_free(simd_viewer->command_arena);
+	if (simd_viewer->history_arena)
+		arena_free(simd_viewer->history_arena);
+	lane_cache_free(&simd_viewer->lane_cache);
+	value_index_free(&simd_viewer->value_index);
+	simd_flow_cache_free(&simd_viewer->flow_cache);
+	simd_debug_ring_destroy(simd_viewer->debug_events);
+
+	array_free(simd_viewer->rows);
+	array_free(simd_viewer->hover_matches);
+	array_free(simd_viewer->matched_rows);
+	for (int layer = 0; layer < SIMD_VIEWER_LAYER_COUNT; ++layer)
+		array_free(simd_viewer->quads[layer]);
+	array_free(simd_viewer->texts);
+	array_free(simd_viewer->history_commands);
+	array_free(simd_viewer->history_frames);
+	array_free(simd_viewer->timings);
+	array_free(simd_viewer->flows);
+	memset(simd_viewer, 0, sizeof(*simd_viewer));
+}
+
+void
+simd_viewer_set_retained(SimdViewer* simd_viewer, bool retained)
+{
+	simd_viewer->retained = retained;
+}
+
+void
+simd_viewer_enable_history(SimdViewer* simd_viewer, bool enable)
+{
+	if (enable && !simd_viewer->history_arena)
+		simd_viewer->history_arena = arena_create(SIMD_VIEWER_HISTORY_ARENA_SIZE);
+	if (!enable)
+		simd_viewer->history_cursor = -1;
+	simd_viewer->history_enabled = enable;
+}
+
+void
+simd_viewer_clear_history(SimdViewer* simd_viewer)
+{
+	if (simd_viewer->history_arena)
+		arena_clear(simd_viewer->history_arena);
+	array_clear(simd_viewer->history_commands);
+	array_clear(simd_viewer->history_frames);
+	simd_viewer->history_hash = 0;
+	simd_viewer->history_cursor = -1;
+	simd_viewer->layout_hash = 0;
+}
+
+void
+simd_viewer_set_idle(SimdViewer* simd_viewer, bool idle)
+{
+	simd_viewer->idle = idle;
+}
+
+void
+simd_viewer_request_redraw(SimdViewer* simd_viewer)
+{
+	simd_viewer->redraw_requested = true;
+}
+
+void
+simd_viewer_enable_debug_events(SimdViewer* simd_viewer, bool enable)
+{
+	if (enable && !simd_viewer->debug_events)
+		simd_viewer->debug_events = simd_debug_ring_create();
+	if (!enable)
+	{
+		simd_debug_ring_destroy(simd_viewer->debug_events);
+		simd_viewer->debug_events = 0;
+		simd_viewer->show_debug_overlay = false;
+	}
+}
+
+void
+simd_viewer_show_debug_overlay(SimdViewer* simd_viewer, bool show)
+{
+	if (show)
+		simd_viewer_enable_debug_events(simd_viewer, true);
+	simd_viewer->show_debug_overlay = show;
+}
+
+void
+simd_viewer_set_thread_filter(SimdViewer* simd_viewer, int32_t thread)
 {
-	return (Vector2) { 20.0f, 20.0f + (float)((BYTE_SIZE + Y_SPACING) * index) };
+	simd_viewer->thread_filter = (thread < 0) ? -1 : thread;
+	simd_viewer->scroll_y = 0;
 }
 
-function Rectangle
-render_box_colored(Vector2 pos, int byte_size, Color color)
+void
+simd_viewer_enable_timing(SimdViewer* simd_viewer, bool enable)
 {
-	Rectangle rect = {
-		.x = pos.x,
-		.y = pos.y,
-		.width = (float)box_width(byte_size),
-		.height = (float)BYTE_SIZE
-	};
-	DrawRectangleRec(rect, color);
-	return rect;
+	simd_viewer->timing_enabled = enable;
+	simd_viewer->timing_open = 0;
 }
 
-function void
-render_linebox_colored(Vector2 pos, int byte_size, Color color)
+void
+simd_viewer_set_bench(SimdViewer* simd_viewer, SimdBench* bench)
 {
-	DrawRectangleLines((int)pos.x, (int)pos.y + 1, box_width(byte_size), BYTE_SIZE - 2, color);
+	simd_viewer->bench = bench;
 }
 
-function Rectangle
-render_box(Vector2 pos, int byte_size)
+void
+simd_viewer_show_flow(SimdViewer* simd_viewer, bool show)
 {
-	Color c = LIGHTGRAY;
-	c.r += 20;
-	return render_box_colored(pos, byte_size, c);
+	simd_viewer->show_flow = show;
 }
 
-function Rectangle
-render_box_highlight(Vector2 pos, int byte_size, bool should_highlight)
+void
+simd_viewer_dump_debug_events(SimdViewer* simd_viewer, FILE* file)
 {
-	Color c = LIGHTGRAY;
-	c.r += 20;
-	if (should_highlight)
-	{
-		c.r = 255;
-		c.g += 30;
-	}
-	return render_box_colored(pos, byte_size, c);
+	simd_debug_dump(simd_viewer->debug_events, file);
 }
 
-function void
-render_text_centered(Vector2 pos, Font font, const char* text, int width)
+void
+simd_viewer_clear(SimdViewer* simd_viewer)
 {
-	Vector2 measure = MeasureTextEx(font, text, (float)font.baseSize, 0);
-	DrawTextEx(font, text, Vector2Add(pos, (Vector2) { width / 2 - measure.x / 2, BYTE_SIZE / 2 - measure.y / 2 }), (float)font.baseSize, 0, FONT_COLOR);
+	arena_clear(simd_viewer->command_arena);
+	simd_viewer->first_command = 0;
+	simd_viewer->last_command = 0;
+	simd_viewer->stack_index = 0;
+	simd_viewer->pushed_flags = 0;
+	simd_viewer->last_register_size = sizeof(__m256i);
+	simd_viewer->command_hash = FNV_OFFSET_BASIS;
+	simd_viewer->layout_hash = 0;
 }
 
+// Flush
 function void
-render_text_rightalign(Vector2 pos, Font font, const char* text, int width)
+set_view_size(SimdViewer* sv, int height)
 {
-	Vector2 measure = MeasureTextEx(font, text, (float)font.baseSize, 0);
-	DrawTextEx(font, text, Vector2Add(pos, (Vector2) { width - measure.x - 4, BYTE_SIZE / 2 - measure.y / 2 }), (float)font.baseSize, 0, FONT_COLOR);
+	sv->view_height = (float)(sv->history_enabled ? height - TIMELINE_HEIGHT : height);
 }
 
-function const char*
-text_for_register_lane(AnyValue value, int32_t index, bool hex)
+void
+simd_viewer_flush(SimdViewer* simd_viewer)
 {
-	const char* view_format = fmt(hex, value.type);
-	switch (value.register_size_bytes * 8)
+	finish_timing(simd_viewer);
+	int width = GetScreenWidth();
+	int height = GetScreenHeight();
+	set_view_size(simd_viewer, height);
+
+	Vector2 mouse = GetMousePosition();
+	update_thread_filter(simd_viewer);
+	update_timeline(simd_viewer, mouse, width);
+	if (simd_viewer->layout_hash != content_hash(simd_viewer))
+		layout_commands(simd_viewer);
+
+	update_scroll(simd_viewer, mouse, width, (int)simd_viewer->view_height);
+	update_hovered(simd_viewer, mouse);
+	update_hover_matches(simd_viewer);
+	update_highlighter(simd_viewer, mouse);
+
+	if (simd_viewer->target.id == 0 || simd_viewer->target.texture.width != width || simd_viewer->target.texture.height != height)
 	{
-		case 128: {
-			switch (value.type)
-			{
-				case REGISTER_TYPE_S8:  return TextFormat(view_format, simd_extract_s8_from_128(value.i128, index));
-				case REGISTER_TYPE_S16: return TextFormat(view_format, simd_extract_s16_from_128(value.i128, index));
-				case REGISTER_TYPE_S32: return TextFormat(view_format, simd_extract_s32_from_128(value.i128, index));
-				case REGISTER_TYPE_S64: return TextFormat(view_format, simd_extract_s64_from_128(value.i128, index));
-				case REGISTER_TYPE_U8:  return TextFormat(view_format, simd_extract_u8_from_128(value.i128, index));
-				case REGISTER_TYPE_U16: return TextFormat(view_format, simd_extract_u16_from_128(value.i128, index));
-				case REGISTER_TYPE_U32: return TextFormat(view_format, simd_extract_u32_from_128(value.i128, index));
-				case REGISTER_TYPE_U64: return TextFormat(view_format, simd_extract_u64_from_128(value.i128, index));
-				case REGISTER_TYPE_F32: return TextFormat("%f", simd_extract_f32_from_128(value.f128, index));
-				case REGISTER_TYPE_F64:	return TextFormat("%f", simd_extract_f64_from_128(value.f128d, index));
-			}
-		} break;
-		case 256: {
-			switch (value.type)
-			{
-				case REGISTER_TYPE_S8:  return TextFormat(view_format, simd_extract_s8_from_256(value.i256, index));
-				case REGISTER_TYPE_S16: return TextFormat(view_format, simd_extract_s16_from_256(value.i256, index));
-				case REGISTER_TYPE_S32: return TextFormat(view_format, simd_extract_s32_from_256(value.i256, index));
-				case REGISTER_TYPE_S64: return TextFormat(view_format, simd_extract_s64_from_256(value.i256, index));
-				case REGISTER_TYPE_U8:  return TextFormat(view_format, simd_extract_u8_from_256(value.i256, index));
-				case REGISTER_TYPE_U16: return TextFormat(view_format, simd_extract_u16_from_256(value.i256, index));
-				case REGISTER_TYPE_U32: return TextFormat(view_format, simd_extract_u32_from_256(value.i256, index));
-				case REGISTER_TYPE_U64: return TextFormat(view_format, simd_extract_u64_from_256(value.i256, index));
-				case REGISTER_TYPE_F32: return TextFormat("%f", simd_extract_f32_from_256(value.f256, index));
-				case REGISTER_TYPE_F64: return TextFormat("%f", simd_extract_f64_from_256(value.f256d, index));
-			}
-		} break;
+		if (simd_viewer->target.id != 0)
+			UnloadRenderTexture(simd_viewer->target);
+		simd_viewer->target = LoadRenderTexture(width, height);
+		simd_viewer->view_hash = 0;
+	}
+
+	// Nothing that affects the picture changed, the last frame is drawn as is
+	uint64_t view_hash = view_state_hash(simd_viewer);
+	if (view_hash != simd_viewer->view_hash)
+	{
+		BeginTextureMode(simd_viewer->target);
+		ClearBackground(BACKGROUND_COLOR);
+		render_commands(simd_viewer, &raylib_backend, width, height);
+		EndTextureMode();
+		simd_viewer->view_hash = view_hash;
+		simd_debug_push(simd_viewer->debug_events, SIMD_DEBUG_EVENT_REDRAW, simd_viewer->frame_index, (int32_t)array_length(simd_viewer->rows), 0, view_hash);
+	}
+	DrawTextureRec(simd_viewer->target.texture, (Rectangle) { 0, 0, (float)width, -(float)height }, (Vector2) { 0, 0 }, WHITE);
+
+	if (simd_viewer->show_debug_overlay)
+		render_debug_overlay(simd_viewer, width, height);
+	simd_viewer->frame_index++;
+
+	// Decided after drawing, raylib waits for events in EndDrawing
+	bool wait = simd_viewer->idle && !simd_viewer->redraw_requested;
+	if (wait != simd_viewer->event_waiting)
+	{
+		if (wait) EnableEventWaiting();
+		else DisableEventWaiting();
+		simd_viewer->event_waiting = wait;
 	}
+	simd_viewer->redraw_requested = false;
 
-	return "";
+	arena_clear(simd_viewer->frame_arena);
+
+	record_history(simd_viewer);
+	if (!simd_viewer->retained)
+		simd_viewer_clear(simd_viewer);
 }
 
-#define CONCATENATE(prefix, name, suffix)   prefix ## name ## suffix
-#define EXTRACT_FUNCTION(TYPE, SIZE, SIGN)  function TYPE          \
-extract_##SIGN##SIZE(AnyValue value, int32_t index)              \
-{                                                                \
-	switch (value.register_size_bytes * 8)                       \
-	{                                                            \
-		case 128: return CONCATENATE(simd_extract_, SIGN##SIZE, _from_128)(value.i128, index);  \
-		case 256: return CONCATENATE(simd_extract_, SIGN##SIZE, _from_256)(value.i256, index);  \
-		default: assert(false);                                  \
-	}                                                            \
+Image
+simd_viewer_render_image(SimdViewer* simd_viewer, int width, int height)
+{
+	finish_timing(simd_viewer);
+	set_view_size(simd_viewer, height);
+	if (simd_viewer->layout_hash != content_hash(simd_viewer))
+		layout_commands(simd_viewer);
+
+	Image image = GenImageColor(width, height, BACKGROUND_COLOR);
+	SimdSoftwareRenderer renderer = simd_software_renderer(&image);
+	render_commands(simd_viewer, &renderer.backend, width, height);
+
+	arena_clear(simd_viewer->frame_arena);
+	simd_viewer->frame_index++;
+
+	record_history(simd_viewer);
+	if (!simd_viewer->retained)
+		simd_viewer_clear(simd_viewer);
+	return image;
 }
 
-EXTRACT_FUNCTION(int8_t, 8, s)
-EXTRACT_FUNCTION(uint8_t, 8, u)
-EXTRACT_FUNCTION(int16_t, 16, s)
-EXTRACT_FUNCTION(uint16_t, 16, u)
-EXTRACT_FUNCTION(int32_t, 32, s)
-EXTRACT_FUNCTION(uint32_t, 32, u)
-EXTRACT_FUNCTION(int64_t, 64, s)
-EXTRACT_FUNCTION(uint64_t, 64, u)
+// ----------------------------------------------------------------------------------------------
+// Terminal
 
-function float
-extract_f32(AnyValue value, int32_t index)
+function Color
+blend_color(Color base, Color over)
 {
-	switch (value.register_size_bytes * 8)
-	{
-		case 128: return simd_extract_f32_from_128(value.f128, index);
-		case 256: return simd_extract_f32_from_256(value.f256, index);
-	}
+	Color result = {
+		(unsigned char)((over.r * over.a + base.r * (255 - over.a)) / 255),
+		(unsigned char)((over.g * over.a + base.g * (255 - over.a)) / 255),
+		(unsigned char)((over.b * over.a + base.b * (255 - over.a)) / 255),
+		255
+	};
+	return result;
 }
 
-function double
-extract_f64(AnyValue value, int32_t index)
+function void
+ansi_color(FILE* file, Color background, Color foreground, bool bold)
 {
-	switch (value.register_size_bytes * 8)
-	{
-		case 128: return simd_extract_f64_from_128(value.f128d, index);
-		case 256: return simd_extract_f64_from_256(value.f256d, index);
-	}
+	fprintf(file, "\x1b[%d;48;2;%d;%d;%d;38;2;%d;%d;%dm", bold ? 1 : 22, background.r, background.g, background.b, foreground.r, foreground.g, foreground.b);
 }
 
-function bool
-same_value(AnyValue value, int32_t index, AnyValue compared, int32_t compared_index)
+function void
+ansi_centered(FILE* file, const char* text, int width)
 {
-	if (value.type != compared.type)
-		return false;
+	int length = (int)strlen(text);
+	if (length > width)
+		length = width;
+	int left = (width - length) / 2;
+	fprintf(file, "%*s%.*s%*s", left, "", length, text, width - length - left, "");
+}
 
-	switch (value.type)
+// Each register byte takes chars_per_byte columns, so rows of every lane size line up as in the window
+function void
+ansi_register(SimdViewer* sv, FILE* file, const SimdViewerCommand* command, const char** text, int chars_per_byte)
+{
+	const AnyValue* any = &command->value;
+	bool bold = command->flags & SIMD_VIEWER_RENDER_BORDER;
+	const char* separator = bold ? "\xe2\x94\x83" : "\xe2\x94\x82";  // heavy or light vertical bar
+	Color lane_color = { 220, 200, 200, 255 };
+	Color highlight = GOLD;
+	highlight.a = 60;
+
+	uint32_t lane_size = regtype_to_bytesize(any->type);
+	int lane_count = any->register_size_bytes / lane_size;
+	for (int i = lane_count - 1; i >= 0; --i)
 	{
-		case REGISTER_TYPE_S8: return extract_s8(value, index) == extract_s8(compared, compared_index);
-		case REGISTER_TYPE_U8: return extract_u8(value, index) == extract_u8(compared, compared_index);
-		case REGISTER_TYPE_S16: return extract_s16(value, index) == extract_s16(compared, compared_index);
-		case REGISTER_TYPE_U16: return extract_u16(value, index) == extract_u16(compared, compared_index);
-		case REGISTER_TYPE_S32: return extract_s32(value, index) == extract_s32(compared, compared_index);
-		case REGISTER_TYPE_U32: return extract_u32(value, index) == extract_u32(compared, compared_index);
-		case REGISTER_TYPE_S64: return extract_s64(value, index) == extract_s64(compared, compared_index);
-		case REGISTER_TYPE_U64: return extract_u64(value, index) == extract_u64(compared, compared_index);
-		case REGISTER_TYPE_F32: return extract_f32(value, index) == extract_f32(compared, compared_index);
-		case REGISTER_TYPE_F64: return extract_f64(value, index) == extract_f64(compared, compared_index);
+		// Same groups the window tints, every other highlight_size bytes from the left
+		uint32_t column = (lane_count - 1 - i) * lane_size;
+		Color background = lane_color;
+		if ((command->flags & SIMD_VIEWER_RENDER_HIGHLIGHT) && sv->highlight_size > 0 && (column / sv->highlight_size) % 2 == 0)
+			background = blend_color(background, highlight);
+		if ((command->flags & SIMD_VIEWER_RENDER_MASK) && !((any->lane_mask >> i) & 1))
+			background = blend_color(background, (Color) { 0x20, 0x20, 0x20, 0x80 });
+
+		ansi_color(file, background, FONT_COLOR, bold);
+		fprintf(file, "%s%*s", separator, lane_size * chars_per_byte - 1, text[i]);
 	}
-
-	return false;
+	ansi_color(file, lane_color, FONT_COLOR, bold);
+	fprintf(file, "%s\x1b[0m\n", separator);
 }
 
-function ValueHovered
-render_register(SimdViewer* sv, Vector2 pos, AnyValue any, RenderFlag flag)
+function void
+ansi_mask(FILE* file, uint64_t mask, int bit_count, int register_size, int chars_per_byte)
 {
-	Font font = sv->font;
-	uint32_t highlight_size = sv->highlight_size;
-	Vector2 mouse = GetMousePosition();
-
-	if (flag & SIMD_VIEWER_RENDER_BORDER)
+	int lane_size = (register_size / bit_count > 0) ? register_size / bit_count : 1;
+	for (int i = bit_count - 1; i >= 0; --i)
 	{
-		Vector2 border_pos = (Vector2){ pos.x - BORDER_SIZE, pos.y - BORDER_SIZE };
-		Rectangle border_rect = (Rectangle){ .x = pos.x - BORDER_SIZE, .y = pos.y - BORDER_SIZE, .width = (float)(box_width(any.register_size_bytes) + BORDER_SIZE * 2), BYTE_SIZE + BORDER_SIZE * 2 };
-		DrawRectangleLinesEx(border_rect, BORDER_SIZE, (Color) { 0x20, 0x20, 0x20, 0xff });
+		bool set = (mask >> i) & 1;
+		ansi_color(file, set ? LIME : DARKGRAY, RAYWHITE, false);
+		fprintf(file, " ");
+		ansi_centered(file, set ? "1" : "0", lane_size * chars_per_byte - 1);
 	}
+	fprintf(file, " \x1b[0m\n");
+}
 
-	uint16_t division_size = regtype_to_bytesize(any.type);
-	Vector2 render_position = pos;
-	for (int i = any.register_size_bytes / division_size - 1; i >= 0; --i)
-	{
-		bool same = same_value(any, i, sv->hovered.last_value, sv->hovered.last_index);
-		if(same)
-		{
-			printf("Same value: %d %d | %d %d\n", i, sv->hovered.last_index, extract_u8(any, i), extract_u8(sv->hovered.last_value, sv->hovered.last_index));
-		}
-
-		Rectangle boxrect = render_box_highlight(render_position, division_size, same);
-		render_text_rightalign(render_position, font, text_for_register_lane(any, i, flag & SIMD_VIEWER_RENDER_HEX), box_width(division_size));
+void
+simd_viewer_print_ansi(SimdViewer* simd_viewer, FILE* file)
+{
+	finish_timing(simd_viewer);
 
-		if (CheckCollisionPointRec(mouse, boxrect))
+	// Formatted first, the widest lane text decides the columns per byte for every row
+	const char** texts = array_new(const char*);
+	int chars_per_byte = 2;
+	for (SimdViewerCommand* command = simd_viewer->first_command; command; command = command->next)
+	{
+		if (command->kind != SIMD_VIEWER_COMMAND_REGISTER)
+			continue;
+
+		SimdLanes lanes = decode_lanes(command->value);
+		uint32_t lane_size = regtype_to_bytesize(command->value.type);
+		int lane_count = command->value.register_size_bytes / lane_size;
+		const char* lane_text[sizeof(__m512i)];
+		simd_format_lanes(simd_viewer->frame_arena, &lanes, command->value.type, lane_count, command->flags & SIMD_VIEWER_RENDER_HEX, lane_text);
+		for (int i = 0; i < lane_count; ++i)
 		{
-			sv->hovered.frame_index = i;
-			sv->hovered.frame_value = any;
+			int needed = ((int)strlen(lane_text[i]) + 1 + lane_size - 1) / lane_size;
+			if (needed > chars_per_byte)
+				chars_per_byte = needed;
+			array_push(texts, lane_text[i]);
 		}
-
-		render_position = Vector2Add(render_position, (Vector2) { (BYTE_SIZE + SPACING) * division_size, 0 });
 	}
 
-	if (flag & SIMD_VIEWER_RENDER_HIGHLIGHT && highlight_size > 0)
+	size_t text_index = 0;
+	for (SimdViewerCommand* command = simd_viewer->first_command; command; command = command->next)
 	{
-		Vector2 sz_pos = pos;
-		Color highlight_color = GOLD;
-		highlight_color.a = 60;
-
-		for (int i = 0; i < any.register_size_bytes / highlight_size; ++i)
+		switch (command->kind)
 		{
-			if (i % 2 == 0)
-				render_box_colored(sz_pos, highlight_size, highlight_color);
-			sz_pos = Vector2Add(sz_pos, (Vector2) { (BYTE_SIZE + SPACING)* highlight_size, 0 });
+			case SIMD_VIEWER_COMMAND_REGISTER:
+				ansi_register(simd_viewer, file, command, texts + text_index, chars_per_byte);
+				text_index += command->value.register_size_bytes / regtype_to_bytesize(command->value.type);
+				break;
+			case SIMD_VIEWER_COMMAND_OPERATION:
+				ansi_color(file, RED, RAYWHITE, true);
+				ansi_centered(file, operation_label(simd_viewer, command), command->register_size * chars_per_byte + 1);
+				fprintf(file, "\x1b[0m\n");
+				break;
+			case SIMD_VIEWER_COMMAND_MASK:
+				ansi_mask(file, command->value.lane_mask, command->bit_count, command->register_size, chars_per_byte);
+				break;
+			case SIMD_VIEWER_COMMAND_EMPTY:
+				fprintf(file, "\n");
+				break;
+			default: break;
 		}
 	}
+	fflush(file);
+
+	array_free(texts);
+	arena_clear(simd_viewer->frame_arena);
+	if (!simd_viewer->retained)
+		simd_viewer_clear(simd_viewer);
 }
 
-function void
-render_operation256(Font font, Vector2 pos, const char* description, int byte_size)
+function AnyValue
+make_anyvalue_from_i512(__m512i value, RegisterType regtype)
 {
-	Color redish = RED;
-	redish.a = 200;
-	render_box_colored(pos, sizeof(__m256i), redish);
-
-	Vector2 inner_pos = pos;
-	for (int i = sizeof(__m256d) / byte_size - 1; i >= 0; --i)
-	{
-		render_linebox_colored(inner_pos, byte_size, (Color) { 0x50, 0x50, 0x50, 0x30 });
-		inner_pos = Vector2Add(inner_pos, (Vector2) { (float)((BYTE_SIZE + SPACING) * byte_size), 0 });
-	}
-
-	render_text_centered(pos, font, description, box_width(sizeof(__m256i)));
+	assert(regtype >= REGISTER_TYPE_S8 && regtype <= REGISTER_TYPE_U64 && "Register type must be integer type");
+	AnyValue result = {
+		.type = regtype,
+		.register_size_bytes = sizeof(__m512i),
+		.i512 = value,
+	};
+	return result;
 }
 
-// Initialization
-void 
-simd_viewer_init(SimdViewer* simd_viewer)
+function AnyValue
+make_anyvalue_from_f512(__m512 value, RegisterType regtype)
 {
-	simd_viewer->font = LoadFontEx("res/LiberationMono-Regular.ttf", 20, 0, 1024);
-	simd_viewer->default_render_flags = 0;
-	simd_viewer->stack_index = 0;
-	simd_viewer->highlight_size = 0;
+	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
+	AnyValue result = {
+		.type = regtype,
+		.register_size_bytes = sizeof(__m512),
+		.f512 = value,
+	};
+	return result;
 }
 
-// Flush
-void
-simd_viewer_flush(SimdViewer* simd_viewer)
+function AnyValue
+make_anyvalue_from_f512d(__m512d value, RegisterType regtype)
 {
-	simd_viewer->stack_index = 0;
-	simd_viewer->pushed_flags = 0;
-
-	simd_viewer->hovered.last_index = simd_viewer->hovered.frame_index;
-	simd_viewer->hovered.last_value = simd_viewer->hovered.frame_value;
-	simd_viewer->hovered.frame_index = -1;
-	simd_viewer->hovered.frame_value = (AnyValue){ 0 };
+	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
+	AnyValue result = {
+		.type = regtype,
+		.register_size_bytes = sizeof(__m512d),
+		.f512d = value,
+	};
+	return result;
 }
 
 function AnyValue
@@ -398,169 +1681,323 @@ make_anyvalue_from_f128(__m128 value, RegisterType regtype)
 }
 
 // Push
+void
+simd_viewer_push512(SimdViewer* simd_viewer, __m512i reg, RegisterType regtype)
+{
+	assert(regtype >= REGISTER_TYPE_S8 && regtype <= REGISTER_TYPE_U64 && "Register type must be integer type");
+	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags;
+	push_register(simd_viewer, make_anyvalue_from_i512(reg, regtype), flags);
+}
+
+void
+simd_viewer_push512_bold(SimdViewer* simd_viewer, __m512i reg, RegisterType regtype)
+{
+	assert(regtype >= REGISTER_TYPE_S8 && regtype <= REGISTER_TYPE_U64 && "Register type must be integer type");
+	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags | SIMD_VIEWER_RENDER_BORDER;
+	push_register(simd_viewer, make_anyvalue_from_i512(reg, regtype), flags);
+}
+
+void
+simd_viewer_push512f(SimdViewer* simd_viewer, __m512 reg, RegisterType regtype)
+{
+	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
+	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags;
+	push_register(simd_viewer, make_anyvalue_from_f512(reg, regtype), flags);
+}
+
+void
+simd_viewer_push512f_bold(SimdViewer* simd_viewer, __m512 reg, RegisterType regtype)
+{
+	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
+	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags | SIMD_VIEWER_RENDER_BORDER;
+	push_register(simd_viewer, make_anyvalue_from_f512(reg, regtype), flags);
+}
+
+void
+simd_viewer_push512d(SimdViewer* simd_viewer, __m512d reg, RegisterType regtype)
+{
+	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
+	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags;
+	push_register(simd_viewer, make_anyvalue_from_f512d(reg, regtype), flags);
+}
+
+void
+simd_viewer_push512d_bold(SimdViewer* simd_viewer, __m512d reg, RegisterType regtype)
+{
+	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
+	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags | SIMD_VIEWER_RENDER_BORDER;
+	push_register(simd_viewer, make_anyvalue_from_f512d(reg, regtype), flags);
+}
+
+void
+simd_viewer_push512_masked(SimdViewer* simd_viewer, __m512i reg, __mmask64 mask, RegisterType regtype)
+{
+	assert(regtype >= REGISTER_TYPE_S8 && regtype <= REGISTER_TYPE_U64 && "Register type must be integer type");
+	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags | SIMD_VIEWER_RENDER_MASK;
+	AnyValue value = make_anyvalue_from_i512(reg, regtype);
+	value.lane_mask = mask;
+	push_register(simd_viewer, value, flags);
+}
+
+void
+simd_viewer_push512f_masked(SimdViewer* simd_viewer, __m512 reg, __mmask16 mask)
+{
+	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags | SIMD_VIEWER_RENDER_MASK;
+	AnyValue value = make_anyvalue_from_f512(reg, REGISTER_TYPE_F32);
+	value.lane_mask = mask;
+	push_register(simd_viewer, value, flags);
+}
+
+void
+simd_viewer_push512d_masked(SimdViewer* simd_viewer, __m512d reg, __mmask8 mask)
+{
+	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags | SIMD_VIEWER_RENDER_MASK;
+	AnyValue value = make_anyvalue_from_f512d(reg, REGISTER_TYPE_F64);
+	value.lane_mask = mask;
+	push_register(simd_viewer, value, flags);
+}
+
+void
+simd_viewer_push_mask8(SimdViewer* simd_viewer, __mmask8 mask)
+{
+	push_mask(simd_viewer, mask, 8);
+}
+
+void
+simd_viewer_push_mask16(SimdViewer* simd_viewer, __mmask16 mask)
+{
+	push_mask(simd_viewer, mask, 16);
+}
+
+void
+simd_viewer_push_mask32(SimdViewer* simd_viewer, __mmask32 mask)
+{
+	push_mask(simd_viewer, mask, 32);
+}
+
+void
+simd_viewer_push_mask64(SimdViewer* simd_viewer, __mmask64 mask)
+{
+	push_mask(simd_viewer, mask, 64);
+}
+
 void
 simd_viewer_push(SimdViewer* simd_viewer, __m256i reg, RegisterType regtype)
 {
 	assert(regtype >= REGISTER_TYPE_S8 && regtype <= REGISTER_TYPE_U64 && "Register type must be integer type");
-	uint32_t index = simd_viewer->stack_index++;
 	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags;
-	render_register(simd_viewer, line_position(index), make_anyvalue_from_i256(reg, regtype), flags);
+	push_register(simd_viewer, make_anyvalue_from_i256(reg, regtype), flags);
 }
 
 void 
 simd_viewer_push_bold(SimdViewer* simd_viewer, __m256i reg, RegisterType regtype)
 {
 	assert(regtype >= REGISTER_TYPE_S8 && regtype <= REGISTER_TYPE_U64 && "Register type must be integer type");
-	uint32_t index = simd_viewer->stack_index++;
 	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags | SIMD_VIEWER_RENDER_BORDER;
-	render_register(simd_viewer, line_position(index), make_anyvalue_from_i256(reg, regtype), flags);
+	push_register(simd_viewer, make_anyvalue_from_i256(reg, regtype), flags);
 }
 
 void
 simd_viewer_pushf(SimdViewer* simd_viewer, __m256 reg, RegisterType regtype)
 {
 	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
-	uint32_t index = simd_viewer->stack_index++;
 	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags;
-	render_register(simd_viewer, line_position(index), make_anyvalue_from_f256(reg, regtype), flags);
+	push_register(simd_viewer, make_anyvalue_from_f256(reg, regtype), flags);
 }
 
 void
 simd_viewer_pushd(SimdViewer* simd_viewer, __m256d reg, RegisterType regtype)
 {
 	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
-	uint32_t index = simd_viewer->stack_index++;
 	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags;
-	render_register(simd_viewer, line_position(index), make_anyvalue_from_f256d(reg, regtype), flags);
+	push_register(simd_viewer, make_anyvalue_from_f256d(reg, regtype), flags);
 }
 
 void
 simd_viewer_pushd_bold(SimdViewer* simd_viewer, __m256d reg, RegisterType regtype)
 {
 	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
-	uint32_t index = simd_viewer->stack_index++;
 	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags | SIMD_VIEWER_RENDER_BORDER;
-	render_register(simd_viewer, line_position(index), make_anyvalue_from_f256d(reg, regtype), flags);
+	push_register(simd_viewer, make_anyvalue_from_f256d(reg, regtype), flags);
 }
 
 void
 simd_viewer_pushf_bold(SimdViewer* simd_viewer, __m256 reg, FRegisterType regtype)
 {
 	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
-	uint32_t index = simd_viewer->stack_index++;
 	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags | SIMD_VIEWER_RENDER_BORDER;
-	render_register(simd_viewer, line_position(index), make_anyvalue_from_f256(reg, regtype), flags);
+	push_register(simd_viewer, make_anyvalue_from_f256(reg, regtype), flags);
 }
 
 void 
 simd_viewer_push128(SimdViewer* simd_viewer, __m128i reg, RegisterType regtype)
 {
 	assert(regtype >= REGISTER_TYPE_S8 && regtype <= REGISTER_TYPE_U64 && "Register type must be integer type");
-	uint32_t index = simd_viewer->stack_index++;
 	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags;
-	render_register(simd_viewer, line_position(index), make_anyvalue_from_i128(reg, regtype), flags);
+	push_register(simd_viewer, make_anyvalue_from_i128(reg, regtype), flags);
 }
 
 void 
 simd_viewer_push128f(SimdViewer* simd_viewer, __m128 reg, RegisterType regtype)
 {
 	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
-	uint32_t index = simd_viewer->stack_index++;
 	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags;
-	render_register(simd_viewer, line_position(index), make_anyvalue_from_f128(reg, regtype), flags);
+	push_register(simd_viewer, make_anyvalue_from_f128(reg, regtype), flags);
 }
 
 void 
 simd_viewer_push128_bold(SimdViewer* simd_viewer, __m128i reg, RegisterType regtype)
 {
 	assert(regtype >= REGISTER_TYPE_S8 && regtype <= REGISTER_TYPE_U64 && "Register type must be integer type");
-	uint32_t index = simd_viewer->stack_index++;
 	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags | SIMD_VIEWER_RENDER_BORDER;
-	render_register(simd_viewer, line_position(index), make_anyvalue_from_i128(reg, regtype), flags);
+	push_register(simd_viewer, make_anyvalue_from_i128(reg, regtype), flags);
 }
 
 void 
 simd_viewer_push128f_bold(SimdViewer* simd_viewer, __m128 reg, RegisterType regtype)
 {
 	assert(regtype >= REGISTER_TYPE_F32 && regtype <= REGISTER_TYPE_F64 && "Register type must be float type");
-	uint32_t index = simd_viewer->stack_index++;
 	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags | SIMD_VIEWER_RENDER_BORDER;
-	render_register(simd_viewer, line_position(index), make_anyvalue_from_f128(reg, regtype), flags);
+	push_register(simd_viewer, make_anyvalue_from_f128(reg, regtype), flags);
+}
+
+function SimdViewerCommand*
+push_operation(SimdViewer* sv, RegisterType regtype, const char* name, int32_t immediate)
+{
+	SimdViewerCommand* command = push_command(sv, SIMD_VIEWER_COMMAND_OPERATION);
+	size_t length = strlen(name) + 1;
+	command->name = memcpy(arena_alloc(sv->command_arena, length), name, length);
+	command->division = regtype;
+	command->register_size = sv->last_register_size;
+	command->immediate = immediate;
+	return command;
 }
 
 void
 simd_viewer_push_operation(SimdViewer* simd_viewer, RegisterType regtype, const char* name)
 {
-	uint32_t index = simd_viewer->stack_index++;
-	render_operation256(simd_viewer->font, line_position(index), name, regtype_to_bytesize(regtype));
+	simd_viewer_push_operation_imm(simd_viewer, regtype, name, -1);
+}
+
+void
+simd_viewer_push_operation_imm(SimdViewer* simd_viewer, RegisterType regtype, const char* name, int32_t immediate)
+{
+	SimdViewerCommand* command = push_operation(simd_viewer, regtype, name, immediate);
+	if (!simd_viewer->timing_enabled)
+	{
+		commit_command(simd_viewer, command);
+		return;
+	}
+
+	// The previous step ended when this push was entered, the next one starts once it's recorded
+	close_step(simd_viewer, simd_viewer->timing_pushed);
+	open_step(simd_viewer, command, hash_bytes(FNV_OFFSET_BASIS, name, strlen(name)));
+	commit_command(simd_viewer, command);
+	simd_viewer->timing_excluded = 0;
+	simd_viewer->timing_start = read_tsc();
 }
 
 void 
 simd_viewer_push_empty(SimdViewer* simd_viewer)
 {
-	simd_viewer->stack_index++;
+	commit_command(simd_viewer, push_command(simd_viewer, SIMD_VIEWER_COMMAND_EMPTY));
 }
 
-void
-simd_viewer_push_highlighter(SimdViewer* simd_viewer)
+// Replay
+function void
+replay_record(SimdViewer* sv, const SimdCaptureRecord* record, const char* callsite_name)
 {
-	Color overlay = (Color){ 50, 50, 50, 50 };
-	Vector2 mouse = GetMousePosition();
+	if (!simd_capture_record_valid(record))
+		return;
 
-	uint32_t index = simd_viewer->stack_index++;
+	sv->push_thread = record->thread;
+	if (record->kind == SIMD_CAPTURE_OPERATION)
+	{
+		// Replaying isn't what the kernel cost, replayed markers aren't timed
+		commit_command(sv, push_operation(sv, (RegisterType)record->type, callsite_name, -1));
+		sv->push_thread = 0;
+		return;
+	}
 
-	simd_viewer->pushed_flags |= SIMD_VIEWER_RENDER_HIGHLIGHT;
+	AnyValue value = { .type = (RegisterType)record->type, .register_size_bytes = record->register_size_bytes, .lane_mask = record->lane_mask };
+	memcpy(&value.i512, record->bytes, record->register_size_bytes);
+	uint32_t flags = sv->default_render_flags | sv->pushed_flags;
+	if (record->masked)
+		flags |= SIMD_VIEWER_RENDER_MASK;
+	push_register(sv, value, flags);
+	sv->push_thread = 0;
+}
 
-	Vector2 pos = line_position(index);
-	render_box_colored(pos, sizeof(__m256i), ORANGE);
+function void
+replay_collected(void* user, const SimdCaptureRing* ring, const SimdCaptureRecord* record)
+{
+	replay_record(user, record, simd_capture_callsite_name(ring, record->callsite));
+}
 
-	Rectangle rects[] = {
-		{.x = pos.x, .y = pos.y, box_width(sizeof(uint8_t)), BYTE_SIZE },
-		{.x = pos.x, .y = pos.y, box_width(sizeof(uint16_t)), BYTE_SIZE },
-		{.x = pos.x, .y = pos.y, box_width(sizeof(uint32_t)), BYTE_SIZE },
-		{.x = pos.x, .y = pos.y, box_width(sizeof(uint64_t)), BYTE_SIZE },
-		{.x = pos.x, .y = pos.y, box_width(sizeof(__m128i)), BYTE_SIZE },
-		{.x = pos.x, .y = pos.y, box_width(sizeof(__m256i)), BYTE_SIZE },
-	};
-	int sizes[] = {
-		sizeof(uint8_t),
-		sizeof(uint16_t),
-		sizeof(uint32_t),
-		sizeof(uint64_t),
-		sizeof(__m128i),
-		sizeof(__m256i),
-	};
+void
+simd_viewer_replay(SimdViewer* simd_viewer, const SimdCaptureRing* ring)
+{
+	uint64_t count = simd_capture_count(ring);
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		const SimdCaptureRecord* record = simd_capture_at(ring, i);
+		replay_record(simd_viewer, record, simd_capture_callsite_name(ring, record->callsite));
+	}
+}
+
+void
+simd_viewer_replay_collector(SimdViewer* simd_viewer, SimdCaptureCollector* collector)
+{
+	simd_capture_collect(collector, replay_collected, simd_viewer);
+}
+
+void
+simd_viewer_replay_trace(SimdViewer* simd_viewer, const SimdTrace* trace, uint64_t first, uint64_t count)
+{
+	if (first >= trace->record_count)
+		return;
+	if (count > trace->record_count - first)
+		count = trace->record_count - first;
+
+	SimdTraceCursor cursor;
+	SimdCaptureRecord record;
+	simd_trace_cursor_init(trace, &cursor);
+	simd_trace_seek(trace, &cursor, first);
+	for (uint64_t i = 0; i < count && simd_trace_next(trace, &cursor, &record); ++i)
+		replay_record(simd_viewer, &record, simd_trace_callsite_name(trace, record.callsite));
+	simd_trace_cursor_free(&cursor);
+}
 
-	for (int i = 0; i < ARRAY_LENGTH(rects); ++i)
+void
+simd_viewer_push_register_file(SimdViewer* simd_viewer, const SimdRegisterFile* registers, const RegisterType* types)
+{
+	static const char* type_names[] = { "", "s8", "s16", "s32", "s64", "u8", "u16", "u32", "u64", "f32", "f64" };
+	const char* prefix = (registers->vector_size == 64) ? "zmm" : (registers->vector_size == 32) ? "ymm" : "xmm";
+	uint32_t flags = simd_viewer->default_render_flags | simd_viewer->pushed_flags;
+	for (uint32_t i = 0; i < registers->vector_count; ++i)
 	{
-		if (CheckCollisionPointRec(mouse, rects[i]))
-		{
-			overlay = ColorBrightness(overlay, -4.0f);
-			render_box_colored(pos, sizes[i], overlay);
-			render_linebox_colored(pos, sizes[i], overlay);
-			render_text_centered(pos, simd_viewer->font, TextFormat("Register %d bits", sizes[i] * 8), box_width(sizeof(__m256i)));
-			if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
-			{
-				simd_viewer->highlight_size = sizes[i];
-			}
-			if (IsMouseButtonPressed(MOUSE_RIGHT_BUTTON))
-			{
-				simd_viewer->highlight_size = 0;
-			}
-			return;
-		}
+		RegisterType type = (types[i] >= REGISTER_TYPE_S8 && types[i] <= REGISTER_TYPE_F64) ? types[i] : REGISTER_TYPE_U32;
+		simd_viewer->last_register_size = registers->vector_size;
+		commit_command(simd_viewer, push_operation(simd_viewer, type, TextFormat("%s%u  %s", prefix, i, type_names[type]), -1));
+
+		AnyValue value = { .type = type, .register_size_bytes = registers->vector_size, .lane_mask = ~0ull };
+		memcpy(&value.i512, &registers->zmm[i], registers->vector_size);
+		push_register(simd_viewer, value, flags);
 	}
 
-	if (simd_viewer->highlight_size > 0)
+	// One bit per byte of the widest register
+	for (uint32_t i = 0; i < registers->mask_count; ++i)
 	{
-		render_linebox_colored(pos, simd_viewer->highlight_size, RAYWHITE);
+		commit_command(simd_viewer, push_operation(simd_viewer, REGISTER_TYPE_U8, TextFormat("k%u", i), -1));
+		push_mask(simd_viewer, registers->k[i], 64);
 	}
-	
-	render_box_colored(pos, sizeof(uint8_t), overlay);
-	render_box_colored(pos, sizeof(uint16_t), overlay);
-	render_box_colored(pos, sizeof(uint32_t), overlay);
-	render_box_colored(pos, sizeof(uint64_t), overlay);
-	render_box_colored(pos, sizeof(__m128i), overlay);
+}
+
+void
+simd_viewer_push_highlighter(SimdViewer* simd_viewer)
+{
+	simd_viewer->pushed_flags |= SIMD_VIEWER_RENDER_HIGHLIGHT;
+	commit_command(simd_viewer, push_command(simd_viewer, SIMD_VIEWER_COMMAND_HIGHLIGHTER));
 }
 
 // Flags
@@ -4,65 +4,42 @@
 #include <immintrin.h>
 #include <raylib.h>
 #include <raymath.h>
+#include <light_arena.h>
+#include "simd_utils.h"
+#include "simd_register.h"
+#include "simd_lane_cache.h"
+#include "simd_value_index.h"
+#include "simd_debug.h"
+#include "simd_bench.h"
+#include "simd_flow.h"
+#include "simd_capture.h"
+#include "simd_trace.h"
+#include "simd_ptrace.h"
 
 #define BYTE_SIZE 48
 #define SPACING 1
 #define BORDER_SIZE 4
 #define Y_SPACING 16
+#define MASK_STRIP_SIZE 6
+#define DEBUG_OVERLAY_LINES 12
+#define SCROLLBAR_WIDTH 12
+#define SIMD_VIEWER_FONT_PATH "res/LiberationMono-Regular.ttf"
+#define SIMD_VIEWER_FONT_SIZE 20
+#define SIMD_VIEWER_FONT_GLYPHS 1024
+#define SCROLLBAR_MIN_THUMB 24
+#define TIMELINE_HEIGHT 56
+#define SIMD_VIEWER_HISTORY_ARENA_SIZE (1024 * 1024)
+#define SIMD_VIEWER_HISTORY_MAX_PUSHES (64 * 1024)
+#define SIMD_VIEWER_FRAME_ARENA_SIZE (64 * 1024)
+#define SIMD_VIEWER_COMMAND_ARENA_SIZE (256 * 1024)
 #define BACKGROUND_COLOR (Color) { 0x50, 0x50, 0x50, 255 }
 #define FONT_COLOR (Color) { 0x10, 0x10, 0x10, 255 }
 
-typedef enum {
-	REGISTER_TYPE_NONE,
-	
-	REGISTER_TYPE_S8,
-	REGISTER_TYPE_S16,
-	REGISTER_TYPE_S32,
-	REGISTER_TYPE_S64,
-
-	REGISTER_TYPE_U8,
-	REGISTER_TYPE_U16,
-	REGISTER_TYPE_U32,
-	REGISTER_TYPE_U64,
-
-	REGISTER_TYPE_F32,
-	REGISTER_TYPE_F64,
-} RegisterType;
-
-typedef enum {
-	FREGISTER_TYPE_NONE,
-	FREGISTER_TYPE_F32,
-	FREGISTER_TYPE_F64,
-} FRegisterType;
-
 typedef struct {
-	RegisterType type; // division type
-
-	uint32_t register_size_bytes;
-	union {
-		uint8_t  u8val;
-		int8_t   s8val;
-		uint16_t u16val;
-		int16_t  s16val;
-		uint32_t u32val;
-		int32_t  s32val;
-		uint64_t u64val;
-		int64_t  s64val;
-		__m128i  i128;
-		__m128   f128;
-		__m128d  f128d;
-		__m256i  i256;
-		__m256   f256;
-		__m256d  f256d;
-	};
-} AnyValue;
-
-typedef struct {
-	int32_t  frame_index;
-	AnyValue frame_value;
-
-	int32_t  last_index;
-	AnyValue last_value;
+	int32_t   row;    // stack row under the mouse, -1 when no register is hovered
+	int32_t   index;  // lane under the mouse
+	AnyValue  value;
+	SimdLanes lanes;
 } ValueHovered;
 
 typedef uint32_t RenderFlag;
@@ -71,6 +48,82 @@ static const RenderFlag SIMD_VIEWER_RENDER_HEX = (1 << 0);
 static const RenderFlag SIMD_VIEWER_RENDER_BORDER = (1 << 1);
 static const RenderFlag SIMD_VIEWER_RENDER_HIGHLIGHT = (1 << 2);
 static const RenderFlag SIMD_VIEWER_RENDER_VALUE_INTENSITY = (1 << 3);
+static const RenderFlag SIMD_VIEWER_RENDER_MASK = (1 << 4);
+
+typedef enum {
+	SIMD_VIEWER_COMMAND_EMPTY,
+	SIMD_VIEWER_COMMAND_REGISTER,
+	SIMD_VIEWER_COMMAND_OPERATION,
+	SIMD_VIEWER_COMMAND_MASK,
+	SIMD_VIEWER_COMMAND_HIGHLIGHTER,
+} SimdViewerCommandKind;
+
+// One recorded push, everything needed to draw the row later
+typedef struct SimdViewerCommand_t {
+	AnyValue value;  // the register, masks keep their bits in value.lane_mask
+	struct SimdViewerCommand_t* next;
+	const char* name;  // operation name, copied into the command arena
+
+	SimdViewerCommandKind kind;
+	RenderFlag   flags;          // flags in effect when the command was pushed
+	RegisterType division;       // lane division of an operation
+	uint32_t     register_size;  // register width operations and masks line up with
+	uint32_t     bit_count;      // opmask width
+	uint16_t     thread;         // capture thread of replayed records, 0 for direct pushes
+	uint32_t     timing;         // timings index + 1 of a timed operation, 0 otherwise
+	int32_t      immediate;      // of an operation, -1 when it takes none
+} SimdViewerCommand;
+
+// Lane mapping of a shuffle banner, from the registers pushed before it to the one pushed after
+typedef struct {
+	int32_t     inputs[SIMD_FLOW_MAX_INPUTS];  // row of each operand
+	int32_t     result;
+	SimdFlowMap map;
+} SimdViewerFlow;
+
+#define SIMD_VIEWER_TIMING_SAMPLES 256
+
+// Cycles of the step an operation marker starts, up to the next marker or the flush, over the
+// last SIMD_VIEWER_TIMING_SAMPLES frames
+typedef struct {
+	uint64_t name_hash;  // a different operation at this position starts the samples over
+	uint32_t samples[SIMD_VIEWER_TIMING_SAMPLES];
+	uint32_t sample_count;
+	uint32_t min;
+	uint32_t median;
+	uint32_t p99;
+	bool     dirty;  // sampled since the statistics were computed
+} SimdViewerTiming;
+
+typedef enum {
+	SIMD_VIEWER_LAYER_BACKGROUND,  // boxes and borders, below the text
+	SIMD_VIEWER_LAYER_OVERLAY,     // highlights and masks, over the text
+	SIMD_VIEWER_LAYER_COUNT,
+} SimdViewerLayer;
+
+typedef struct {
+	Rectangle rect;
+	Color     color;
+} BatchQuad;
+
+typedef struct {
+	Vector2     position;
+	const char* text;  // copied into the frame arena
+} BatchText;
+
+// Commands of one recorded flush, a range of SimdViewer.history_commands
+typedef struct {
+	uint64_t first;
+	uint32_t count;
+	uint64_t frame_index;  // viewer frame it was flushed on
+} HistoryFrame;
+
+// Where the batches of a frame end up, raylib on the window or the software rasterizer
+typedef struct SimdViewerBackend SimdViewerBackend;
+struct SimdViewerBackend {
+	void (*quads)(SimdViewerBackend* backend, const BatchQuad* quads, size_t count);
+	void (*text)(SimdViewerBackend* backend, Font font, const BatchText* texts, size_t count, Color color);
+};
 
 typedef struct {
 	Font font;
@@ -80,23 +133,196 @@ typedef struct {
 	ValueHovered hovered;
 
 	uint32_t highlight_size;
+	uint32_t highlighter_hover_size;  // size under the mouse in the highlighter, 0 if none
 
 	uint32_t stack_index;
+
+	uint32_t last_register_size;    // size of the last register pushed, operations and masks align to it
+	uint32_t widest_register_size;  // widest register in the stack, sizes the highlighter
+
+	Light_Arena* frame_arena;  // lane text of the current frame, cleared on flush
+	LaneCache    lane_cache;   // formatted and measured lanes of registers seen in previous frames
+
+	// Pushes record commands, flush lays them out and draws them
+	bool                retained;  // keep the commands across flushes until simd_viewer_clear
+	Light_Arena*        command_arena;
+	SimdViewerCommand*  first_command;
+	SimdViewerCommand*  last_command;
+	SimdViewerCommand** rows;          // light_array, one command per stack row
+	uint64_t            command_hash;  // hash of everything recorded so far
+	uint64_t            layout_hash;   // command_hash the rows were built for
+
+	// Lanes equal to the hovered one, looked up in the value index built on relayout
+	ValueIndex value_index;
+	uint64_t*  hover_matches;  // light_array, bitmask of matching lanes per row
+	int32_t*   matched_rows;   // light_array, rows with bits set in hover_matches
+	int32_t    matched_row;    // hover the matches were computed for
+	int32_t    matched_index;
+	bool       value_index_stale;
+
+	// Draws of the frame being rendered, light_arrays submitted in one batch per layer
+	BatchQuad* quads[SIMD_VIEWER_LAYER_COUNT];
+	BatchText* texts;
+
+	// Replayed records keep their capture thread, the filter then shows a single thread
+	uint16_t push_thread;    // thread given to the commands being pushed
+	uint16_t thread_count;   // highest thread pushed so far
+	int32_t  thread_filter;  // -1 shows every thread
+
+	// Every flushed frame that changed, browsed with the timeline under the stack
+	bool                history_enabled;
+	Light_Arena*        history_arena;     // copies of the recorded commands
+	SimdViewerCommand** history_commands;  // light_array, every recorded push in order
+	HistoryFrame*       history_frames;    // light_array
+	uint64_t            history_hash;      // command hash of the last recorded frame
+	int64_t             history_cursor;    // last push shown, -1 follows the live commands
+	bool                timeline_drag;
+
+	float view_height;  // screen height above the timeline
+	float scroll_y;     // content offset of the top of the screen
+	float scroll_drag;  // mouse offset into the scrollbar thumb while dragging it, -1 otherwise
+
+	RenderTexture2D target;     // last drawn frame, reused while the view hash doesn't change
+	uint64_t        view_hash;
+
+	bool idle;              // block in EndDrawing until there is input instead of polling
+	bool event_waiting;     // state last given to raylib
+	bool redraw_requested;  // poll once more even if idle, for data that didn't come with input
+
+	// Timing mode reads rdtscp at every operation marker. The time spent in the viewer's own
+	// pushes is left out, a step only costs what the kernel did between its markers.
+	bool              timing_enabled;
+	SimdViewerTiming* timings;           // light_array, one per operation marker of a frame, in push order
+	uint32_t          timing_operation;  // markers pushed since the last flush
+	uint32_t          timing_open;       // timings index + 1 of the step being measured, 0 if none
+	uint64_t          timing_start;      // rdtscp after the open step's marker
+	uint64_t          timing_pushed;     // rdtscp on entering the push being recorded
+	uint64_t          timing_excluded;   // cycles spent in pushes since the open step started
+
+	SimdBench* bench;  // latency and throughput of the intrinsics on the banners, null to hide them
+
+	// Lanes of shuffles colour coded by where they come from, found on relayout
+	bool            show_flow;
+	SimdFlowCache   flow_cache;
+	SimdViewerFlow* flows;  // light_array
+
+	uint64_t       frame_index;
+	SimdDebugRing* debug_events;  // null unless debug events are enabled
+	bool           show_debug_overlay;
 } SimdViewer;
 
 // Initialization
 void simd_viewer_init(SimdViewer* simd_viewer);
+// Releases everything the viewer holds, the font and render target included
+void simd_viewer_free(SimdViewer* simd_viewer);
 
-// Flush
+// Needs no window or GPU, the font's glyphs are rasterized on the CPU for simd_viewer_render_image.
+// The font is still read from SIMD_VIEWER_FONT_PATH, relative to the working directory. Without
+// it the images come out without text.
+void simd_viewer_init_headless(SimdViewer* simd_viewer);
+
+// Flush, draws the recorded commands. Unless retained, the commands are cleared afterwards.
 void simd_viewer_flush(SimdViewer* simd_viewer);
 
+// Headless flush, rasterizes the recorded commands on the CPU into a new R8G8B8A8 image (free with UnloadImage)
+Image simd_viewer_render_image(SimdViewer* simd_viewer, int width, int height);
+
+// Text flush, prints the recorded commands as ANSI colored lane grids. Doesn't use the font, so
+// simd_viewer_init_headless is enough even when the font file can't be found.
+void simd_viewer_print_ansi(SimdViewer* simd_viewer, FILE* file);
+
+// Retained mode keeps the commands across flushes, so the pushes only need to run once
+void simd_viewer_set_retained(SimdViewer* simd_viewer, bool retained);
+void simd_viewer_clear(SimdViewer* simd_viewer);
+
+// History records every flush that changed the commands, the timeline then steps through them
+// by frame (dragging) or by push (left and right arrows). Back at the end it follows the live commands.
+// Past SIMD_VIEWER_HISTORY_MAX_PUSHES the older half of the frames is dropped.
+void simd_viewer_enable_history(SimdViewer* simd_viewer, bool enable);
+void simd_viewer_clear_history(SimdViewer* simd_viewer);
+
+// Idle mode waits for input or a window event before the next frame instead of running at a
+// fixed frame rate. Data pushed from outside the input loop should request a redraw.
+void simd_viewer_set_idle(SimdViewer* simd_viewer, bool idle);
+void simd_viewer_request_redraw(SimdViewer* simd_viewer);
+
+// Debug events are recorded in memory only, dump them or show the overlay to look at them
+void simd_viewer_enable_debug_events(SimdViewer* simd_viewer, bool enable);
+void simd_viewer_show_debug_overlay(SimdViewer* simd_viewer, bool show);
+void simd_viewer_dump_debug_events(SimdViewer* simd_viewer, FILE* file);
+
+// Shows min / median / p99 cycles of every step on its operation banner. The pushes have to run
+// every frame for the statistics to build up, in retained mode each step has a single sample.
+// rdtscp and the calls into the viewer leave a floor of some tens of cycles on every step.
+void simd_viewer_enable_timing(SimdViewer* simd_viewer, bool enable);
+
+// Shows the measured latency and throughput of the intrinsic an operation banner names, for the
+// intrinsics the bench knows. Measured the first time the banner is drawn unless the bench's cache
+// has it. The bench stays the caller's, null hides them again.
+void simd_viewer_set_bench(SimdViewer* simd_viewer, SimdBench* bench);
+
+// Colours the lanes of the registers a shuffle or permute reads, and each result lane like the
+// lane it came from. Hovering a lane outlines where it comes from or goes to. Works for the
+// intrinsics in simd_flow's table, pushed as operand registers, banner, then result register.
+void simd_viewer_show_flow(SimdViewer* simd_viewer, bool show);
+
+// Shows only the rows replayed from one capture thread, -1 shows all of them. Tab cycles through the threads.
+void simd_viewer_set_thread_filter(SimdViewer* simd_viewer, int32_t thread);
+
 // ----------------------------------------------------------------------------------------------
 // Push
 
+// With SIMD_VIEWER_DISABLE defined the pushes expand to nothing, their arguments aren't even
+// evaluated, so instrumented kernels compile to the same code as uninstrumented ones.
+// Arguments with side effects are dropped along with the push.
+
 // Helpers and Markers
+#if !defined(SIMD_VIEWER_DISABLE)
 void simd_viewer_push_highlighter(SimdViewer* simd_viewer);
 void simd_viewer_push_operation(SimdViewer* simd_viewer, RegisterType regtype, const char* name);
+// For intrinsics taking an immediate, the lane mapping depends on it
+void simd_viewer_push_operation_imm(SimdViewer* simd_viewer, RegisterType regtype, const char* name, int32_t immediate);
 void simd_viewer_push_empty(SimdViewer* simd_viewer);
+#else
+#define simd_viewer_push_highlighter(...) ((void)0)
+#define simd_viewer_push_operation(...) ((void)0)
+#define simd_viewer_push_operation_imm(...) ((void)0)
+#define simd_viewer_push_empty(...) ((void)0)
+#endif
+
+// Pushes every record left in a capture ring, oldest first, as if it had been pushed directly
+void simd_viewer_replay(SimdViewer* simd_viewer, const SimdCaptureRing* ring);
+
+// Pushes what every thread of the collector captured so far, merged by timestamp, and hands the slots back
+void simd_viewer_replay_collector(SimdViewer* simd_viewer, SimdCaptureCollector* collector);
+
+// Pushes count records of a mapped trace starting at first, only those records are touched
+// (and in delta traces the ones since the keyframe before first)
+void simd_viewer_replay_trace(SimdViewer* simd_viewer, const SimdTrace* trace, uint64_t first, uint64_t count);
+
+// Pushes every vector register as a banner naming it followed by the register split into
+// types[i] lanes, so vector i is on row 2 * i + 1. The opmask registers come after them.
+void simd_viewer_push_register_file(SimdViewer* simd_viewer, const SimdRegisterFile* registers, const RegisterType* types);
+
+#if !defined(SIMD_VIEWER_DISABLE)
+// 512 bits
+void simd_viewer_push512(SimdViewer* simd_viewer, __m512i reg, RegisterType regtype);
+void simd_viewer_push512_bold(SimdViewer* simd_viewer, __m512i reg, RegisterType regtype);
+void simd_viewer_push512f(SimdViewer* simd_viewer, __m512 reg, RegisterType regtype);
+void simd_viewer_push512f_bold(SimdViewer* simd_viewer, __m512 reg, RegisterType regtype);
+void simd_viewer_push512d(SimdViewer* simd_viewer, __m512d reg, RegisterType regtype);
+void simd_viewer_push512d_bold(SimdViewer* simd_viewer, __m512d reg, RegisterType regtype);
+
+// 512 bits with an opmask, lanes with the mask bit clear are dimmed
+void simd_viewer_push512_masked(SimdViewer* simd_viewer, __m512i reg, __mmask64 mask, RegisterType regtype);
+void simd_viewer_push512f_masked(SimdViewer* simd_viewer, __m512 reg, __mmask16 mask);
+void simd_viewer_push512d_masked(SimdViewer* simd_viewer, __m512d reg, __mmask8 mask);
+
+// Opmask registers, one bit per lane aligned to the last pushed register
+void simd_viewer_push_mask8(SimdViewer* simd_viewer, __mmask8 mask);
+void simd_viewer_push_mask16(SimdViewer* simd_viewer, __mmask16 mask);
+void simd_viewer_push_mask32(SimdViewer* simd_viewer, __mmask32 mask);
+void simd_viewer_push_mask64(SimdViewer* simd_viewer, __mmask64 mask);
 
 // 256 bits
 void simd_viewer_push(SimdViewer* simd_viewer, __m256i reg, RegisterType regtype);
@@ -111,14 +337,49 @@ void simd_viewer_push128(SimdViewer* simd_viewer, __m128i reg, RegisterType regt
 void simd_viewer_push128f(SimdViewer* simd_viewer, __m128 reg, RegisterType regtype);
 void simd_viewer_push128_bold(SimdViewer* simd_viewer, __m128i reg, RegisterType regtype);
 void simd_viewer_push128f_bold(SimdViewer* simd_viewer, __m128 reg, RegisterType regtype);
+#else
+#define simd_viewer_push512(...) ((void)0)
+#define simd_viewer_push512_bold(...) ((void)0)
+#define simd_viewer_push512f(...) ((void)0)
+#define simd_viewer_push512f_bold(...) ((void)0)
+#define simd_viewer_push512d(...) ((void)0)
+#define simd_viewer_push512d_bold(...) ((void)0)
+#define simd_viewer_push512_masked(...) ((void)0)
+#define simd_viewer_push512f_masked(...) ((void)0)
+#define simd_viewer_push512d_masked(...) ((void)0)
+#define simd_viewer_push_mask8(...) ((void)0)
+#define simd_viewer_push_mask16(...) ((void)0)
+#define simd_viewer_push_mask32(...) ((void)0)
+#define simd_viewer_push_mask64(...) ((void)0)
+#define simd_viewer_push(...) ((void)0)
+#define simd_viewer_push_bold(...) ((void)0)
+#define simd_viewer_pushf(...) ((void)0)
+#define simd_viewer_pushf_bold(...) ((void)0)
+#define simd_viewer_pushd(...) ((void)0)
+#define simd_viewer_pushd_bold(...) ((void)0)
+#define simd_viewer_push128(...) ((void)0)
+#define simd_viewer_push128f(...) ((void)0)
+#define simd_viewer_push128_bold(...) ((void)0)
+#define simd_viewer_push128f_bold(...) ((void)0)
+#endif
 
 
 // ----------------------------------------------------------------------------------------------
-// Rendering
+// Rendering, only affects the pushes that follow so it compiles away with them
+#if !defined(SIMD_VIEWER_DISABLE)
 void simd_viewer_reset_flags(SimdViewer* simd_viewer);
 void simd_viewer_set_hexadecimal_render(SimdViewer* simd_viewer);
 void simd_viewer_set_decimal_render(SimdViewer* simd_viewer);
 void simd_viewer_set_highlight_size(SimdViewer* simd_viewer, RegisterType regtype);
 void simd_viewer_reset_hightlight_size(SimdViewer* simd_viewer);
 void simd_viewer_enable_hightlight_size(SimdViewer* simd_viewer);
-void simd_viewer_disable_hightlight_size(SimdViewer* simd_viewer);
\ No newline at end of file
+void simd_viewer_disable_hightlight_size(SimdViewer* simd_viewer);
+#else
+#define simd_viewer_reset_flags(...) ((void)0)
+#define simd_viewer_set_hexadecimal_render(...) ((void)0)
+#define simd_viewer_set_decimal_render(...) ((void)0)
+#define simd_viewer_set_highlight_size(...) ((void)0)
+#define simd_viewer_reset_hightlight_size(...) ((void)0)
+#define simd_viewer_enable_hightlight_size(...) ((void)0)
+#define simd_viewer_disable_hightlight_size(...) ((void)0)
+#endif
\ No newline at end of file